@@ -16,7 +16,8 @@
 #define DISTRHO_PLUGIN_HAS_UI        0
 #define DISTRHO_UI_USE_NANOVG        0
 
-#define DISTRHO_PLUGIN_IS_RT_SAFE       1
+// not real-time safe: changing the number of chips reallocates the emulators
+#define DISTRHO_PLUGIN_IS_RT_SAFE       0
 #define DISTRHO_PLUGIN_IS_SYNTH         1
 #define DISTRHO_PLUGIN_NUM_INPUTS       0
 #define DISTRHO_PLUGIN_NUM_OUTPUTS      2
@@ -0,0 +1,400 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#include "CoreMiniOPL3.h"
+#include "SharedMiniOPL3.h"
+#include <cstring>
+#include <cmath>
+
+// -----------------------------------------------------------------------
+
+CoreMiniOPL3::CoreMiniOPL3()
+    : fRegs{}
+{
+    ADL_Instrument &inst = fRegs.instrument;
+    inst.version = ADLMIDI_InstrumentVersion;
+
+    // XXX: a hack to skip measuring the envelope times
+    inst.delay_off_ms = 65535;
+    inst.delay_on_ms = 65535;
+
+    beginParameterBatch();
+
+    for (unsigned index = 0; index < paramCount; ++index)
+        setParameterValue(index, ParameterInfos[index].def);
+
+    endParameterBatch();
+}
+
+// -----------------------------------------------------------------------
+// Parameters
+
+/**
+  Get the current value of a parameter.
+*/
+float CoreMiniOPL3::getParameterValue(uint32_t index) const
+{
+    DISTRHO_SAFE_ASSERT_RETURN(index < paramCount, 0);
+
+    switch (index) {
+    case paramNumChips:
+        return fRegs.numChips;
+    case paramDeepVibrato:
+        return fRegs.deepVibrato;
+    case paramDeepTremolo:
+        return fRegs.deepTremolo;
+    case paramVolumeModel:
+        return fRegs.volumeModel;
+    default:
+        return GetInstrumentParameter(fRegs.instrument, index);
+    }
+}
+
+/**
+  Change a parameter value.
+*/
+void CoreMiniOPL3::setParameterValue(uint32_t index, float floatingPointValue)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(index < paramCount, );
+
+    int value = (int)std::lrint(floatingPointValue);
+
+    const ParameterInfo &info = ParameterInfos[index];
+    value = (value < info.min) ? info.min : value;
+    value = (value > info.max) ? info.max : value;
+
+    switch (index) {
+    default:
+    {
+        // the 4-op channels are reallocated only if the algorithm changes kind
+        unsigned fourOps = fRegs.instrument.inst_flags & kInstrumentFlag4op;
+        SetInstrumentParameter(fRegs.instrument, index, value);
+        if (fourOps != (fRegs.instrument.inst_flags & kInstrumentFlag4op))
+            requestUpdates(kUpdateProgram|kUpdateFourOps);
+        else
+            requestUpdates(kUpdateProgram);
+        break;
+    }
+
+    case paramDeepVibrato:
+        fRegs.deepVibrato = value;
+        requestUpdates(kUpdateDeepVibrato);
+        break;
+
+    case paramDeepTremolo:
+        fRegs.deepTremolo = value;
+        requestUpdates(kUpdateDeepTremolo);
+        break;
+
+    case paramVolumeModel:
+        fRegs.volumeModel = value;
+        requestUpdates(kUpdateVolumeModel);
+        break;
+
+    case paramNumChips:
+        // changing the chips resets the player, which allocates
+        if (fRegs.numChips == value)
+            break;
+        fRegs.numChips = value;
+        requestUpdates(kUpdateNumChips|kUpdateFourOps);
+        break;
+    }
+}
+
+/**
+  Change all parameter values, applying the updates in one pass.
+*/
+void CoreMiniOPL3::setParameterValues(const float values[])
+{
+    beginParameterBatch();
+
+    for (unsigned index = 0; index < paramCount; ++index)
+        setParameterValue(index, values[index]);
+
+    endParameterBatch();
+}
+
+// -----------------------------------------------------------------------
+// Setup
+
+/**
+  Change the sample rate. The emulator is recreated at the next activation.
+*/
+void CoreMiniOPL3::setSampleRate(double sampleRate)
+{
+    fSampleRate = sampleRate;
+    fPlayer.reset();
+}
+
+/**
+  Select the emulator. The emulator is recreated at the next activation.
+*/
+void CoreMiniOPL3::setEmulator(int emulator)
+{
+    fEmulator = emulator;
+    fPlayer.reset();
+}
+
+// -----------------------------------------------------------------------
+// Process
+
+void CoreMiniOPL3::activate()
+{
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    if (!player) {
+        createPlayer();
+        return;
+    }
+
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceReset);
+    adl_reset(player);
+}
+
+
+void CoreMiniOPL3::run(float **outputs, uint32_t frames,
+                       const MidiEvent *midiEvents, uint32_t midiEventCount)
+{
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    if (!player) {
+        // not activated
+        std::memset(outputs[0], 0, frames * sizeof(float));
+        std::memset(outputs[1], 0, frames * sizeof(float));
+        return;
+    }
+
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceRun, frames);
+
+    ADLMIDI_AudioFormat format;
+    format.type = ADLMIDI_SampleType_F32;
+    format.containerSize = sizeof(float);
+    format.sampleOffset = sizeof(float);
+
+    //
+    float *lOut = outputs[0];
+    float *rOut = outputs[1];
+
+    constexpr uint32_t midiInterval = 64;
+    uint32_t midiIndex = 0;
+
+    for (uint32_t index = 0; index < frames;) {
+        unsigned currentFrames = frames - index;
+        if (currentFrames > midiInterval)
+            currentFrames = midiInterval;
+
+        while (midiIndex < midiEventCount && midiEvents[midiIndex].frame < index + currentFrames)
+            handleEvent(midiEvents[midiIndex++]);
+
+        {
+            MINIOPL3_TRACE_SCOPE(fTrace, kTraceGenerate, currentFrames);
+            MINIOPL3_PROFILE_GENERATE(fProfile);
+            adl_generateFormat(
+                player, 2 * currentFrames,
+                (uint8_t *)(lOut + index),
+                (uint8_t *)(rOut + index),
+                &format);
+        }
+
+        // it's too quiet, give it a +6 dB
+        float boost = 2.0f;
+        for (unsigned i = 0; i < currentFrames; ++i) {
+            lOut[i + index] *= boost;
+            rOut[i + index] *= boost;
+        }
+
+        index += currentFrames;
+    }
+
+    while (midiIndex < midiEventCount)
+        handleEvent(midiEvents[midiIndex++]);
+}
+
+void CoreMiniOPL3::handleEvent(const MidiEvent &event)
+{
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    if (event.size >= 4)
+        return;
+
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceMidiEvent,
+                         event.data[0] | (event.data[1] << 8) | ((uint32_t)event.data[2] << 16));
+    MINIOPL3_PROFILE_EVENT(fProfile, event.data[0], event.data[2]);
+
+    uint8_t status = event.data[0];
+    if (status == 0xff) {
+        adl_reset(player);
+        return;
+    }
+    if ((status & 0xf0) == 0xf0)
+        return;
+
+    uint8_t d1 = event.data[1] & 0x7f;
+    uint8_t d2 = event.data[2] & 0x7f;
+
+    switch (status >> 4) {
+    case 0b1001:
+        if (d2 != 0) {
+            adl_rt_noteOn(player, 0, d1, d2);
+            break;
+        }
+        /* fall through */
+    case 0b1000:
+        adl_rt_noteOff(player, 0, d1);
+        break;
+    case 0b1010:
+        adl_rt_noteAfterTouch(player, 0, d1, d2);
+        break;
+    case 0b1101:
+        adl_rt_channelAfterTouch(player, 0, d1);
+        break;
+    case 0b1011:
+        if (d1 == 0 || d1 == 32)
+            break; // forbid Bank Select CCs
+        adl_rt_controllerChange(player, 0, d1, d2);
+        break;
+    case 0b1110:
+        adl_rt_pitchBendML(player, 0, d2, d1);
+        break;
+
+    // NO program change
+    }
+}
+
+/**
+  Create the emulator, and configure it with the current parameters.
+  This is deferred until activation, so that hosts can instantiate the
+  plugin to query its information without paying for the chip setup.
+*/
+void CoreMiniOPL3::createPlayer()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceCreatePlayer);
+
+    ADL_MIDIPlayer *player = adl_init(fSampleRate);
+    DISTRHO_SAFE_ASSERT_RETURN(player, );
+    fPlayer.reset(player);
+
+    if (fEmulator != -1 && adl_switchEmulator(player, fEmulator) != 0)
+        d_stderr("Could not select the emulator %d", fEmulator);
+
+    performUpdates(kUpdateAll);
+}
+
+// -----------------------------------------------------------------------
+
+/**
+  Start a group of parameter changes.
+  The updates are deferred until the matching call to `endParameterBatch`,
+  which applies every pending update exactly once.
+*/
+void CoreMiniOPL3::beginParameterBatch()
+{
+    ++fBatchDepth;
+}
+
+void CoreMiniOPL3::endParameterBatch()
+{
+    DISTRHO_SAFE_ASSERT_RETURN(fBatchDepth > 0, );
+
+    if (--fBatchDepth == 0) {
+        unsigned flags = fPendingUpdates;
+        fPendingUpdates = 0;
+        performUpdates(flags);
+    }
+}
+
+void CoreMiniOPL3::requestUpdates(unsigned flags)
+{
+    if (fBatchDepth > 0)
+        fPendingUpdates |= flags;
+    else
+        performUpdates(flags);
+}
+
+void CoreMiniOPL3::performUpdates(unsigned flags)
+{
+    // without a player, the parameters get applied when it is created
+    if (!fPlayer)
+        return;
+
+    // chip allocation first, the others apply to the chips in place
+    if (flags & kUpdateNumChips)
+        updateNumChips();
+    if (flags & kUpdateDeepVibrato)
+        updateDeepVibrato();
+    if (flags & kUpdateDeepTremolo)
+        updateDeepTremolo();
+    if (flags & kUpdateVolumeModel)
+        updateVolumeModel();
+    if (flags & kUpdateProgram)
+        updateProgram();
+    if (flags & kUpdateFourOps)
+        updateFourOps();
+}
+
+// -----------------------------------------------------------------------
+
+void CoreMiniOPL3::updateProgram()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateProgram);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    ADL_BankId defaultBankId = {0, 0, 0};
+    ADL_Bank defaultBank = {};
+    adl_getBank(player, &defaultBankId, ADLMIDI_Bank_Create, &defaultBank);
+    adl_setInstrument(player, &defaultBank, 0, &fRegs.instrument);
+}
+
+void CoreMiniOPL3::updateDeepVibrato()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateDeepVibrato);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+    adl_setHVibrato(player, fRegs.deepVibrato);
+}
+
+void CoreMiniOPL3::updateDeepTremolo()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateDeepTremolo);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+    adl_setHTremolo(player, fRegs.deepTremolo);
+}
+
+void CoreMiniOPL3::updateVolumeModel()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateVolumeModel);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+    int model = ADLMIDI_VolumeModel_Generic + fRegs.volumeModel;
+    adl_setVolumeRangeModel(player, model);
+}
+
+void CoreMiniOPL3::updateNumChips()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateNumChips, fRegs.numChips);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    unsigned numchips = fRegs.numChips;
+    adl_setNumChips(player, numchips);
+}
+
+void CoreMiniOPL3::updateFourOps()
+{
+    MINIOPL3_TRACE_SCOPE(fTrace, kTraceUpdateFourOps);
+
+    ADL_MIDIPlayer *player = fPlayer.get();
+
+    unsigned num4ops = 0;
+    unsigned numchips = fRegs.numChips;
+    if (fRegs.instrument.inst_flags & kInstrumentFlag4op)
+        num4ops = 6 * numchips;
+    adl_setNumFourOpsChn(player, num4ops);
+}
@@ -0,0 +1,126 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#ifndef CORE_MINIOPL3_H
+#define CORE_MINIOPL3_H
+
+#include "DistrhoPlugin.hpp"
+#include "TraceMiniOPL3.h"
+#include "ProfileMiniOPL3.h"
+#include <adlmidi.h>
+#include <memory>
+
+// -----------------------------------------------------------------------
+
+/**
+  The synthesizer, independent of the plugin host.
+  It is shared by the plugin and the command line tools.
+*/
+class CoreMiniOPL3 {
+public:
+    CoreMiniOPL3();
+
+    // -------------------------------------------------------------------
+    // Parameters
+
+    float getParameterValue(uint32_t index) const;
+    void setParameterValue(uint32_t index, float value);
+
+    // set all the parameters at once, `values` has `paramCount` elements
+    void setParameterValues(const float values[]);
+
+    void beginParameterBatch();
+    void endParameterBatch();
+
+    // -------------------------------------------------------------------
+    // Setup
+
+    void setSampleRate(double sampleRate);
+
+    // select the emulator by its ADL_Emulator identifier, or -1 for default
+    void setEmulator(int emulator);
+
+    // -------------------------------------------------------------------
+    // Process
+
+    void activate();
+
+    void run(float **outputs, uint32_t frames,
+             const MidiEvent *midiEvents, uint32_t midiEventCount);
+
+    void handleEvent(const MidiEvent &event);
+
+    // -------------------------------------------------------------------
+
+private:
+    void createPlayer();
+
+    enum UpdateFlag {
+        kUpdateProgram = 1 << 0,
+        kUpdateDeepVibrato = 1 << 1,
+        kUpdateDeepTremolo = 1 << 2,
+        kUpdateVolumeModel = 1 << 3,
+        kUpdateNumChips = 1 << 4,
+        kUpdateFourOps = 1 << 5,
+        kUpdateAll = (1 << 6) - 1,
+    };
+
+    void requestUpdates(unsigned flags);
+    void performUpdates(unsigned flags);
+
+    void updateProgram();
+    void updateDeepVibrato();
+    void updateDeepTremolo();
+    void updateVolumeModel();
+    void updateNumChips();
+    void updateFourOps();
+
+    // -------------------------------------------------------------------
+
+private:
+    // parameters, stored as the register image of the chip
+    struct Registers
+    {
+        ADL_Instrument instrument;
+        uint8_t numChips;
+        uint8_t deepVibrato;
+        uint8_t deepTremolo;
+        uint8_t volumeModel;
+    };
+
+    static_assert(sizeof(Registers) <= 64, "the registers should fit in a cache line");
+
+    Registers fRegs;
+
+    struct ADL_delete
+    {
+        void operator()(ADL_MIDIPlayer *x) const noexcept { adl_close(x); }
+    };
+
+    std::unique_ptr<ADL_MIDIPlayer, ADL_delete> fPlayer;
+
+    double fSampleRate = 44100;
+    int fEmulator = -1;
+
+    unsigned fBatchDepth = 0;
+    unsigned fPendingUpdates = 0;
+
+#if MINIOPL3_TRACE
+    TraceRing fTrace;
+#endif
+
+#if MINIOPL3_PROFILE
+    EventProfile fProfile;
+#endif
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoreMiniOPL3)
+};
+
+// -----------------------------------------------------------------------
+
+#endif  // #ifndef CORE_MINIOPL3_H
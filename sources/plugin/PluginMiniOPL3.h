@@ -10,10 +10,7 @@
 #define PLUGIN_MINIOPL3_H
 
 #include "DistrhoPlugin.hpp"
-#include <adlmidi.h>
-#include <memory>
-
-struct ParameterSimpleRange;
+#include "CoreMiniOPL3.h"
 
 // -----------------------------------------------------------------------
 
@@ -101,32 +98,10 @@ protected:
     void run(const float **, float **outputs, uint32_t frames,
              const MidiEvent *midiEvents, uint32_t midiEventCount) override;
 
-    void handleEvent(const MidiEvent &event);
-
-    // -------------------------------------------------------------------
-
-private:
-    void updateProgram();
-    void updateDeepVibrato();
-    void updateDeepTremolo();
-    void updateVolumeModel();
-    void updateNumChips();
-    void updateFourOps();
-
-    ADL_Instrument createInstrumentOfParameters() const;
-
     // -------------------------------------------------------------------
 
 private:
-    std::unique_ptr<int[]> fParams;
-    std::unique_ptr<ParameterSimpleRange[]> fRanges;
-
-    struct ADL_delete
-    {
-        void operator()(ADL_MIDIPlayer *x) const noexcept { adl_close(x); }
-    };
-
-    std::unique_ptr<ADL_MIDIPlayer, ADL_delete> fPlayer;
+    CoreMiniOPL3 fCore;
 
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginMiniOPL3)
 };
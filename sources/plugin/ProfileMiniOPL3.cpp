@@ -0,0 +1,145 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#include "ProfileMiniOPL3.h"
+
+#if MINIOPL3_PROFILE
+
+#include <atomic>
+#include <cstdlib>
+
+// -----------------------------------------------------------------------
+
+static const char *const ProfileEventNames[kProfileEventKindCount] = {
+    "note-on",
+    "note-off",
+    "note-aftertouch",
+    "channel-aftertouch",
+    "controller",
+    "pitch-bend",
+    "reset",
+};
+
+void ProfileHistogram::record(uint64_t ns) noexcept
+{
+    unsigned bucket = 0;
+    for (uint64_t x = ns; x > 1 && bucket < kBucketCount - 1; x >>= 1)
+        ++bucket;
+
+    ++buckets[bucket];
+    ++count;
+    total += ns;
+    max = (ns > max) ? ns : max;
+}
+
+static void writeHistogram(FILE *file, const char *name, const ProfileHistogram &histogram)
+{
+    if (histogram.count == 0)
+        return;
+
+    fprintf(file, "%s\t%llu\t%llu\t%llu\t", name,
+            (unsigned long long)histogram.count,
+            (unsigned long long)(histogram.total / histogram.count),
+            (unsigned long long)histogram.max);
+
+    bool first = true;
+    for (unsigned k = 0; k < ProfileHistogram::kBucketCount; ++k) {
+        if (histogram.buckets[k] == 0)
+            continue;
+        fprintf(file, "%s%u:%llu", first ? "" : " ", k,
+                (unsigned long long)histogram.buckets[k]);
+        first = false;
+    }
+    fputc('\n', file);
+}
+
+// -----------------------------------------------------------------------
+
+EventProfile::EventProfile()
+{
+    static std::atomic<unsigned> nextId{1};
+    fId = nextId.fetch_add(1);
+}
+
+EventProfile::~EventProfile()
+{
+    const char *path = getenv("MINIOPL3_PROFILE_FILE");
+    if (!path || !path[0])
+        return;
+
+    FILE *file = fopen(path, "a");
+    if (!file)
+        return;
+
+    write(file);
+    fclose(file);
+}
+
+uint8_t EventProfile::eventKind(uint8_t status, uint8_t data2) noexcept
+{
+    if (status == 0xff)
+        return kProfileReset;
+
+    switch (status >> 4) {
+    case 0b1001:
+        return (data2 & 0x7f) ? kProfileNoteOn : kProfileNoteOff;
+    case 0b1000:
+        return kProfileNoteOff;
+    case 0b1010:
+        return kProfileNoteAftertouch;
+    case 0b1101:
+        return kProfileChannelAftertouch;
+    case 0b1011:
+        return kProfileController;
+    case 0b1110:
+        return kProfilePitchBend;
+    default:
+        return kProfileEventKindCount;
+    }
+}
+
+void EventProfile::recordEvent(uint8_t kind, uint64_t ns) noexcept
+{
+    fEvents[kind].record(ns);
+    fPendingKinds |= 1u << kind;
+}
+
+void EventProfile::recordGenerate(uint64_t ns) noexcept
+{
+    if (fPendingKinds == 0)
+        fIdleGenerates.record(ns);
+
+    for (unsigned kind = 0; kind < kProfileEventKindCount; ++kind) {
+        if (fPendingKinds & (1u << kind))
+            fGenerates[kind].record(ns);
+    }
+
+    fPendingKinds = 0;
+}
+
+void EventProfile::write(FILE *file) const
+{
+    fprintf(file, "# MiniOPL3 #%u, durations in ns, histogram of log2(ns):count\n", fId);
+    fprintf(file, "# name\tcount\tmean\tmax\thistogram\n");
+
+    for (unsigned kind = 0; kind < kProfileEventKindCount; ++kind)
+        writeHistogram(file, ProfileEventNames[kind], fEvents[kind]);
+
+    char name[64];
+    for (unsigned kind = 0; kind < kProfileEventKindCount; ++kind) {
+        snprintf(name, sizeof(name), "generate-after-%s", ProfileEventNames[kind]);
+        writeHistogram(file, name, fGenerates[kind]);
+    }
+    writeHistogram(file, "generate-idle", fIdleGenerates);
+
+    fputc('\n', file);
+}
+
+// -----------------------------------------------------------------------
+
+#endif // MINIOPL3_PROFILE
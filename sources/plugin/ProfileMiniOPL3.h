@@ -0,0 +1,152 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#ifndef PROFILE_MINIOPL3_H
+#define PROFILE_MINIOPL3_H
+
+// -----------------------------------------------------------------------
+
+/**
+  Profiling of the worst-case execution times, in builds with
+  `MINIOPL3_PROFILE` defined to 1.
+
+  Each instance measures the MIDI events by type of message, and the
+  generation which follows them, into histograms of power-of-two
+  durations. When the instance is destroyed, the histograms are appended
+  to the file named by the environment variable `MINIOPL3_PROFILE_FILE`.
+
+  In other builds, the profiling macros expand to nothing.
+*/
+
+#if MINIOPL3_PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+enum ProfileEventKind : uint8_t {
+    kProfileNoteOn,
+    kProfileNoteOff,
+    kProfileNoteAftertouch,
+    kProfileChannelAftertouch,
+    kProfileController,
+    kProfilePitchBend,
+    kProfileReset,
+    kProfileEventKindCount,
+};
+
+/**
+  A histogram of durations, in nanoseconds.
+  The bucket `k` counts the durations in the range [2^k, 2^(k+1)).
+*/
+struct ProfileHistogram {
+    enum { kBucketCount = 32 };
+
+    uint64_t buckets[kBucketCount] = {};
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    void record(uint64_t ns) noexcept;
+};
+
+/**
+  The histograms of an instance, written by the audio thread only.
+*/
+class EventProfile {
+public:
+    EventProfile();
+    ~EventProfile();
+
+    void recordEvent(uint8_t kind, uint64_t ns) noexcept;
+    // the generation is attributed to the kinds of events which preceded it
+    void recordGenerate(uint64_t ns) noexcept;
+
+    void write(FILE *file) const;
+
+    static uint64_t clock() noexcept
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // the kind of a MIDI message, or kProfileEventKindCount if ignored
+    static uint8_t eventKind(uint8_t status, uint8_t data2) noexcept;
+
+private:
+    ProfileHistogram fEvents[kProfileEventKindCount];
+    ProfileHistogram fGenerates[kProfileEventKindCount];
+    ProfileHistogram fIdleGenerates;
+    unsigned fPendingKinds = 0;
+    unsigned fId = 0;
+
+    EventProfile(const EventProfile &) = delete;
+    EventProfile &operator=(const EventProfile &) = delete;
+};
+
+/**
+  Measures a scope, as a MIDI event or as a generation.
+*/
+class ProfileEventScope {
+public:
+    ProfileEventScope(EventProfile &profile, uint8_t status, uint8_t data2) noexcept
+        : fProfile(profile), fKind(EventProfile::eventKind(status, data2)),
+          fStart(EventProfile::clock())
+    {
+    }
+
+    ~ProfileEventScope() noexcept
+    {
+        if (fKind != kProfileEventKindCount)
+            fProfile.recordEvent(fKind, EventProfile::clock() - fStart);
+    }
+
+private:
+    EventProfile &fProfile;
+    uint8_t fKind;
+    uint64_t fStart;
+
+    ProfileEventScope(const ProfileEventScope &) = delete;
+    ProfileEventScope &operator=(const ProfileEventScope &) = delete;
+};
+
+class ProfileGenerateScope {
+public:
+    explicit ProfileGenerateScope(EventProfile &profile) noexcept
+        : fProfile(profile), fStart(EventProfile::clock())
+    {
+    }
+
+    ~ProfileGenerateScope() noexcept
+    {
+        fProfile.recordGenerate(EventProfile::clock() - fStart);
+    }
+
+private:
+    EventProfile &fProfile;
+    uint64_t fStart;
+
+    ProfileGenerateScope(const ProfileGenerateScope &) = delete;
+    ProfileGenerateScope &operator=(const ProfileGenerateScope &) = delete;
+};
+
+#define MINIOPL3_PROFILE_EVENT(profile, status, data2) \
+    ProfileEventScope profileEventScope{(profile), (status), (data2)}
+#define MINIOPL3_PROFILE_GENERATE(profile) \
+    ProfileGenerateScope profileGenerateScope{(profile)}
+
+#else
+
+#define MINIOPL3_PROFILE_EVENT(profile, status, data2) do {} while (0)
+#define MINIOPL3_PROFILE_GENERATE(profile) do {} while (0)
+
+#endif // MINIOPL3_PROFILE
+
+// -----------------------------------------------------------------------
+
+#endif  // #ifndef PROFILE_MINIOPL3_H
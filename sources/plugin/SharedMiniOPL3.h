@@ -1,75 +1,245 @@
 #pragma once
 #include "DistrhoPlugin.hpp"
 
-#ifndef maybe_unused
-#   if defined(__GNUC__)
-#       define maybe_unused __attribute__((unused))
-#   else
-#       define maybe_unused
-#   endif
-#endif
-
 void InitParameter(uint32_t index, Parameter &parameter);
 
-struct ParameterSimpleRange
+static constexpr uint32_t kParameterIsAutomableInteger =
+    kParameterIsAutomable|kParameterIsInteger;
+static constexpr uint32_t kParameterIsAutomableBoolean =
+    kParameterIsAutomable|kParameterIsInteger|kParameterIsBoolean;
+
+// P(Id, Name, Symbol, Default, Min, Max, Hints, Labels)
+#define MINIOPL3_GLOBAL_PARAMETERS(P) \
+    P(NumChips, "Number of chips", "numchips", 2, 1, 8, /*kParameterIsAutomable|*/kParameterIsInteger, None) \
+    P(DeepVibrato, "Deep vibrato", "deepvibrato", 0, 0, 1, kParameterIsAutomableBoolean, None) \
+    P(DeepTremolo, "Deep tremolo", "deeptremolo", 0, 0, 1, kParameterIsAutomableBoolean, None) \
+    P(VolumeModel, "Volume model", "volmodel", 0, 0, 4, kParameterIsAutomableInteger, VolumeModel) \
+    P(Algorithm, "Algorithm", "algorithm", 0, 0, 9, kParameterIsAutomableInteger, Algorithm) \
+    P(Feedback1, "Feedback 1-2", "feedback1", 0, 0, 7, kParameterIsAutomableInteger, None) \
+    P(Feedback2, "Feedback 3-4 (4op, 2x2op)", "feedback2", 0, 0, 7, kParameterIsAutomableInteger, None) \
+    P(Transpose1, "Transpose 1-2", "transpose1", 0, -127, 128, kParameterIsAutomableInteger, None) \
+    P(Transpose2, "Transpose 3-4 (2x2op)", "transpose2", 0, -127, 128, kParameterIsAutomableInteger, None) \
+    P(FineTune2, "Fine tune 3-4 (2x2op)", "finetune2", 0, -127, 127, kParameterIsAutomableInteger, None) \
+    P(VelOffset, "Velocity offset", "veloffset", 0, -127, 127, kParameterIsAutomableInteger, None)
+
+#define MINIOPL3_OPERATOR_PARAMETERS(P, X) \
+    P(Op##X##Attack, "Operator " #X " attack", "op" #X "attack", 0, 0, 15, kParameterIsAutomableInteger, None) \
+    P(Op##X##Decay, "Operator " #X " decay", "op" #X "decay", 0, 0, 15, kParameterIsAutomableInteger, None) \
+    P(Op##X##Sustain, "Operator " #X " sustain", "op" #X "sustain", 0, 0, 15, kParameterIsAutomableInteger, None) \
+    P(Op##X##Release, "Operator " #X " release", "op" #X "release", 0, 0, 15, kParameterIsAutomableInteger, None) \
+    P(Op##X##Wave, "Operator " #X " waveform", "op" #X "wave", 0, 0, 7, kParameterIsAutomableInteger, Waveform) \
+    P(Op##X##Fmul, "Operator " #X " frequency multipler", "op" #X "fmul", 0, 0, 15, kParameterIsAutomableInteger, None) \
+    P(Op##X##Level, "Operator " #X " level", "op" #X "level", 0, 0, 63, kParameterIsAutomableInteger, None) \
+    P(Op##X##KSL, "Operator " #X " key scale level", "op" #X "ksl", 0, 0, 3, kParameterIsAutomableInteger, None) \
+    P(Op##X##Vib, "Operator " #X " vibrato", "op" #X "vib", 0, 0, 1, kParameterIsAutomableBoolean, None) \
+    P(Op##X##Am, "Operator " #X " tremolo", "op" #X "am", 0, 0, 1, kParameterIsAutomableBoolean, None) \
+    P(Op##X##Eg, "Operator " #X " sustained", "op" #X "eg", 0, 0, 1, kParameterIsAutomableBoolean, None) \
+    P(Op##X##KSR, "Operator " #X " key-scaled", "op" #X "ksr", 0, 0, 1, kParameterIsAutomableBoolean, None)
+
+#define MINIOPL3_PARAMETERS(P) \
+    MINIOPL3_GLOBAL_PARAMETERS(P) \
+    MINIOPL3_OPERATOR_PARAMETERS(P, 1) \
+    MINIOPL3_OPERATOR_PARAMETERS(P, 2) \
+    MINIOPL3_OPERATOR_PARAMETERS(P, 3) \
+    MINIOPL3_OPERATOR_PARAMETERS(P, 4)
+
+enum ParameterId
 {
-    float def = 0.0;
-    float min = 0.0;
-    float max = 1.0;
+    #define PARAMETER_ID(Id, Name, Symbol, Def, Min, Max, Hints, Labels) \
+        param##Id,
+
+    MINIOPL3_PARAMETERS(PARAMETER_ID)
+
+    #undef PARAMETER_ID
+
+    paramCount
+};
+
+struct ParameterInfo
+{
+    const char *name;
+    const char *symbol;
+    float def;
+    float min;
+    float max;
+    uint32_t hints;
+    // enumeration labels, for the values from min to max
+    const char *const *labels;
+    unsigned labelCount;
+};
+
+// read-only description of parameters, shared by all instances
+extern const ParameterInfo ParameterInfos[paramCount];
+
+// instrument flags, identical in ADL_Instrument and WOPLInstrument
+enum InstrumentFlag
+{
+    kInstrumentFlag4op = 0x01,
+    kInstrumentFlagPseudo4op = 0x02,
+};
 
-    ParameterSimpleRange()
+inline bool IsInstrumentParameter(unsigned index)
+{
+    return index >= paramAlgorithm && index < paramCount;
+}
+
+/**
+  Get the value of an instrument parameter, decoding the registers.
+  `Instrument` is either ADL_Instrument or WOPLInstrument.
+*/
+template <class Instrument>
+int GetInstrumentParameter(const Instrument &inst, unsigned index)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(IsInstrumentParameter(index), 0);
+
+    switch (index) {
+    case paramAlgorithm:
     {
+        int alg = inst.fb_conn1_C0 & 1;
+        if (inst.inst_flags & kInstrumentFlag4op) {
+            alg |= (inst.fb_conn2_C0 & 1) << 1;
+            alg += 2;
+            if (inst.inst_flags & kInstrumentFlagPseudo4op)
+                alg += 4;
+        }
+        return alg;
+    }
+    case paramFeedback1:
+        return (inst.fb_conn1_C0 >> 1) & 7;
+    case paramFeedback2:
+        return (inst.fb_conn2_C0 >> 1) & 7;
+    case paramTranspose1:
+        return inst.note_offset1;
+    case paramTranspose2:
+        return inst.note_offset2;
+    case paramFineTune2:
+        return inst.second_voice_detune;
+    case paramVelOffset:
+        return inst.midi_velocity_offset;
     }
 
-    ParameterSimpleRange(const ParameterRanges &other) noexcept
-        : def{other.def}, min{other.min}, max{other.max}
-    {
+    const unsigned stride = paramOp2Attack - paramOp1Attack;
+    const unsigned o = (index - paramOp1Attack) / stride;
+    const auto &op = inst.operators[o ^ 1];
+
+    switch (paramOp1Attack + (index - paramOp1Attack) % stride) {
+    case paramOp1Attack:
+        return op.atdec_60 >> 4;
+    case paramOp1Decay:
+        return op.atdec_60 & 15;
+    case paramOp1Sustain:
+        return 15 - (op.susrel_80 >> 4);
+    case paramOp1Release:
+        return op.susrel_80 & 15;
+    case paramOp1Wave:
+        return op.waveform_E0 & 7;
+    case paramOp1Fmul:
+        return op.avekf_20 & 15;
+    case paramOp1Level:
+        return 63 - (op.ksl_l_40 & 63);
+    case paramOp1KSL:
+        return op.ksl_l_40 >> 6;
+    case paramOp1Vib:
+        return (op.avekf_20 >> 6) & 1;
+    case paramOp1Am:
+        return (op.avekf_20 >> 7) & 1;
+    case paramOp1Eg:
+        return (op.avekf_20 >> 5) & 1;
+    case paramOp1KSR:
+        return (op.avekf_20 >> 4) & 1;
+    default:
+        return 0;
     }
-};
+}
 
-enum ParameterId
+/**
+  Set the value of an instrument parameter, encoding the registers.
+  The value must be in the range of the parameter.
+*/
+template <class Instrument>
+void SetInstrumentParameter(Instrument &inst, unsigned index, int value)
 {
-    paramNumChips,
-
-    paramDeepVibrato,
-    paramDeepTremolo,
-    paramVolumeModel,
-
-    paramAlgorithm,
-    paramFeedback1,
-    paramFeedback2,
-    paramTranspose1,
-    paramTranspose2,
-    paramFineTune2,
-    paramVelOffset,
-
-    #define PER_OP(F, X)       \
-        F(Attack, X)           \
-        F(Decay, X)            \
-        F(Sustain, X)          \
-        F(Release, X)          \
-        F(Wave, X)             \
-        F(Fmul, X)             \
-        F(Level, X)            \
-        F(KSL, X)              \
-        F(Vib, X)              \
-        F(Am, X)               \
-        F(Eg, X)               \
-        F(KSR, X)
-
-    #define OP_PARAMETER(P, X) \
-        paramOp##X##P,
-
-    PER_OP(OP_PARAMETER, 1)
-    PER_OP(OP_PARAMETER, 2)
-    PER_OP(OP_PARAMETER, 3)
-    PER_OP(OP_PARAMETER, 4)
-
-    #undef PER_OP
-    #undef OP_PARAMETER
+    DISTRHO_SAFE_ASSERT_RETURN(IsInstrumentParameter(index), );
 
-    paramCount
-};
+    switch (index) {
+    case paramAlgorithm:
+        inst.fb_conn1_C0 &= ~1;
+        inst.fb_conn2_C0 &= ~1;
+        inst.inst_flags &= ~(kInstrumentFlag4op|kInstrumentFlagPseudo4op);
+        if (value < 2)
+            inst.fb_conn1_C0 |= value;
+        else {
+            unsigned alg4 = value - 2;
+            inst.fb_conn1_C0 |= alg4 & 1;
+            inst.fb_conn2_C0 |= (alg4 >> 1) & 1;
+            inst.inst_flags |= kInstrumentFlag4op;
+            if (alg4 >= 4)
+                inst.inst_flags |= kInstrumentFlagPseudo4op;
+        }
+        return;
+    case paramFeedback1:
+        inst.fb_conn1_C0 = (inst.fb_conn1_C0 & ~(7 << 1)) | (value << 1);
+        return;
+    case paramFeedback2:
+        inst.fb_conn2_C0 = (inst.fb_conn2_C0 & ~(7 << 1)) | (value << 1);
+        return;
+    case paramTranspose1:
+        inst.note_offset1 = value;
+        return;
+    case paramTranspose2:
+        inst.note_offset2 = value;
+        return;
+    case paramFineTune2:
+        inst.second_voice_detune = value;
+        return;
+    case paramVelOffset:
+        inst.midi_velocity_offset = value;
+        return;
+    }
+
+    const unsigned stride = paramOp2Attack - paramOp1Attack;
+    const unsigned o = (index - paramOp1Attack) / stride;
+    auto &op = inst.operators[o ^ 1];
+
+    switch (paramOp1Attack + (index - paramOp1Attack) % stride) {
+    case paramOp1Attack:
+        op.atdec_60 = (op.atdec_60 & 0x0f) | (value << 4);
+        break;
+    case paramOp1Decay:
+        op.atdec_60 = (op.atdec_60 & 0xf0) | value;
+        break;
+    case paramOp1Sustain:
+        op.susrel_80 = (op.susrel_80 & 0x0f) | ((15 - value) << 4);
+        break;
+    case paramOp1Release:
+        op.susrel_80 = (op.susrel_80 & 0xf0) | value;
+        break;
+    case paramOp1Wave:
+        op.waveform_E0 = value;
+        break;
+    case paramOp1Fmul:
+        op.avekf_20 = (op.avekf_20 & 0xf0) | value;
+        break;
+    case paramOp1Level:
+        op.ksl_l_40 = (op.ksl_l_40 & 0xc0) | (63 - value);
+        break;
+    case paramOp1KSL:
+        op.ksl_l_40 = (op.ksl_l_40 & 0x3f) | (value << 6);
+        break;
+    case paramOp1Vib:
+        op.avekf_20 = (op.avekf_20 & ~(1 << 6)) | (value << 6);
+        break;
+    case paramOp1Am:
+        op.avekf_20 = (op.avekf_20 & ~(1 << 7)) | (value << 7);
+        break;
+    case paramOp1Eg:
+        op.avekf_20 = (op.avekf_20 & ~(1 << 5)) | (value << 5);
+        break;
+    case paramOp1KSR:
+        op.avekf_20 = (op.avekf_20 & ~(1 << 4)) | (value << 4);
+        break;
+    }
+}
 
 enum StateId
 {
@@ -82,12 +252,6 @@ struct Program
     float values[paramCount];
 };
 
-maybe_unused static const Program EmbeddedPrograms[] = {
-    {
-        "Default piano",
-        {2,1,1,4,0,4,0,0,0,0,0,15,2,0,4,0,1,48,2,0,0,0,0,15,2,0,7,0,1,57,0,0,0,0,0,0,0,15,0,0,0,63,0,0,0,0,0,0,0,15,0,0,0},
-    },
-};
-
-maybe_unused static const unsigned programCount =
-    sizeof(EmbeddedPrograms) / sizeof(EmbeddedPrograms[0]);
+// read-only table of programs, optionally generated from banks at build time
+extern const Program EmbeddedPrograms[];
+extern const unsigned programCount;
@@ -0,0 +1,279 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#include "TraceMiniOPL3.h"
+
+#if MINIOPL3_TRACE
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+// -----------------------------------------------------------------------
+
+uint64_t traceClock() noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+/**
+  Collects the rings of all the instances, from a thread which runs as
+  long as some instance exists. The file is written in the JSON array
+  format, which does not require the closing bracket.
+*/
+class TraceCollector {
+public:
+    static TraceCollector &instance();
+
+    unsigned add(TraceRing *ring);
+    void remove(TraceRing *ring);
+
+private:
+    void run();
+    bool openFile();
+    void closeFile();
+    void drain(TraceRing &ring);
+    void writeEvent(unsigned tid, const TraceEvent &event);
+
+private:
+    std::mutex fMutex;
+    std::condition_variable fCond;
+    std::vector<TraceRing *> fRings;
+    std::thread fThread;
+    bool fStopping = false;
+
+    FILE *fFile = nullptr;
+    bool fFileStarted = false;
+    uint64_t fEpoch = traceClock();
+    unsigned fNextId = 1;
+
+    std::vector<TraceEvent> fEvents;
+};
+
+TraceCollector &TraceCollector::instance()
+{
+    // never destroyed, the rings can outlive the static objects
+    static TraceCollector *collector = new TraceCollector;
+    return *collector;
+}
+
+unsigned TraceCollector::add(TraceRing *ring)
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+
+    // let the collector thread finish stopping, if it is
+    fCond.wait(lock, [this]() { return !fStopping; });
+
+    unsigned id = fNextId++;
+    fRings.push_back(ring);
+
+    if (!fThread.joinable() && openFile())
+        fThread = std::thread([this]() { run(); });
+
+    if (fFile) {
+        fprintf(fFile,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                "\"args\":{\"name\":\"MiniOPL3 #%u\"}},\n", id, id);
+    }
+
+    return id;
+}
+
+void TraceCollector::remove(TraceRing *ring)
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+
+    drain(*ring);
+    fRings.erase(std::remove(fRings.begin(), fRings.end(), ring), fRings.end());
+
+    if (!fRings.empty() || !fThread.joinable())
+        return;
+
+    // the last instance is gone, stop before the code can be unloaded
+    fStopping = true;
+    fCond.notify_all();
+    std::thread thread = std::move(fThread);
+    lock.unlock();
+    thread.join();
+    lock.lock();
+
+    closeFile();
+    fStopping = false;
+    fCond.notify_all();
+}
+
+void TraceCollector::run()
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+
+    while (!fStopping) {
+        fCond.wait_for(lock, std::chrono::milliseconds(50), [this]() { return fStopping; });
+        for (TraceRing *ring : fRings)
+            drain(*ring);
+        fflush(fFile);
+    }
+}
+
+bool TraceCollector::openFile()
+{
+    const char *path = getenv("MINIOPL3_TRACE_FILE");
+    if (!path || !path[0])
+        return false;
+
+    // a new process truncates the file, and then the events are appended
+    fFile = fopen(path, fFileStarted ? "a" : "w");
+    if (!fFile)
+        return false;
+
+    if (!fFileStarted) {
+        fputs("[\n", fFile);
+        fFileStarted = true;
+    }
+
+    return true;
+}
+
+void TraceCollector::closeFile()
+{
+    if (fFile) {
+        fclose(fFile);
+        fFile = nullptr;
+    }
+}
+
+void TraceCollector::drain(TraceRing &ring)
+{
+    const size_t maxCount = 1024;
+    fEvents.resize(maxCount);
+
+    size_t count;
+    while ((count = ring.read(fEvents.data(), maxCount)) > 0) {
+        if (!fFile)
+            continue;
+        for (size_t i = 0; i < count; ++i)
+            writeEvent(ring.id(), fEvents[i]);
+    }
+
+    uint32_t dropped = ring.takeDropped();
+    if (dropped > 0 && fFile) {
+        uint64_t time = traceClock() - fEpoch;
+        fprintf(fFile,
+                "{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu.%03u,"
+                "\"pid\":0,\"tid\":%u,\"args\":{\"count\":%u}},\n",
+                (unsigned long long)(time / 1000), (unsigned)(time % 1000),
+                ring.id(), dropped);
+    }
+}
+
+void TraceCollector::writeEvent(unsigned tid, const TraceEvent &event)
+{
+    static const char *const names[kTraceEventKindCount] = {
+        "run",
+        "generate",
+        "midi",
+        "createPlayer",
+        "reset",
+        "updateProgram",
+        "updateDeepVibrato",
+        "updateDeepTremolo",
+        "updateVolumeModel",
+        "updateNumChips",
+        "updateFourOps",
+    };
+
+    if (event.kind >= kTraceEventKindCount)
+        return;
+
+    uint64_t time = (event.time > fEpoch) ? (event.time - fEpoch) : 0;
+
+    char args[64] = "";
+    switch (event.kind) {
+    case kTraceRun:
+    case kTraceGenerate:
+        snprintf(args, sizeof(args), ",\"args\":{\"frames\":%u}", event.arg);
+        break;
+    case kTraceMidiEvent:
+        snprintf(args, sizeof(args), ",\"args\":{\"message\":\"%02x %02x %02x\"}",
+                 event.arg & 0xff, (event.arg >> 8) & 0xff, (event.arg >> 16) & 0xff);
+        break;
+    case kTraceUpdateNumChips:
+        snprintf(args, sizeof(args), ",\"args\":{\"chips\":%u}", event.arg);
+        break;
+    }
+
+    // complete events, which the viewers nest by their times
+    fprintf(fFile,
+            "{\"name\":\"%s\",\"cat\":\"miniopl3\",\"ph\":\"X\",\"ts\":%llu.%03u,"
+            "\"dur\":%u.%03u,\"pid\":0,\"tid\":%u%s},\n",
+            names[event.kind],
+            (unsigned long long)(time / 1000), (unsigned)(time % 1000),
+            event.duration / 1000, event.duration % 1000, tid, args);
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------
+
+TraceRing::TraceRing()
+{
+    fId = TraceCollector::instance().add(this);
+}
+
+TraceRing::~TraceRing()
+{
+    TraceCollector::instance().remove(this);
+}
+
+void TraceRing::record(uint8_t kind, uint32_t arg, uint64_t time, uint64_t duration) noexcept
+{
+    size_t writeIndex = fWriteIndex.load(std::memory_order_relaxed);
+    size_t readIndex = fReadIndex.load(std::memory_order_acquire);
+
+    if (writeIndex - readIndex >= kCapacity) {
+        fDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent &event = fEvents[writeIndex & (kCapacity - 1)];
+    event.time = time;
+    event.duration = (uint32_t)std::min<uint64_t>(duration, UINT32_MAX);
+    event.arg = arg;
+    event.kind = kind;
+
+    fWriteIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+size_t TraceRing::read(TraceEvent *events, size_t maxCount) noexcept
+{
+    size_t readIndex = fReadIndex.load(std::memory_order_relaxed);
+    size_t writeIndex = fWriteIndex.load(std::memory_order_acquire);
+
+    size_t count = std::min(writeIndex - readIndex, maxCount);
+    for (size_t i = 0; i < count; ++i)
+        events[i] = fEvents[(readIndex + i) & (kCapacity - 1)];
+
+    fReadIndex.store(readIndex + count, std::memory_order_release);
+    return count;
+}
+
+uint32_t TraceRing::takeDropped() noexcept
+{
+    return fDropped.exchange(0, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------
+
+#endif // MINIOPL3_TRACE
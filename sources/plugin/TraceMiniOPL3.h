@@ -0,0 +1,138 @@
+/*
+ * MiniOPL3 audio effect based on DISTRHO Plugin Framework (DPF)
+ *
+ * SPDX-License-Identifier: BSL-1.0
+ *
+ * Copyright (C) 2019 Jean Pierre Cimalando <jp-dev@inbox.ru>
+ */
+
+#ifndef TRACE_MINIOPL3_H
+#define TRACE_MINIOPL3_H
+
+// -----------------------------------------------------------------------
+
+/**
+  Tracing of the processing, for latency debugging, in builds with
+  `MINIOPL3_TRACE` defined to 1.
+
+  Each instance records timestamped events into its own ring buffer, without
+  locking or allocating. A background thread collects the rings of all the
+  instances, and writes the events into the file named by the environment
+  variable `MINIOPL3_TRACE_FILE`, in the Chrome trace format which Perfetto
+  can open too. Without the variable, the events are recorded and discarded.
+
+  In other builds, the tracing macros expand to nothing.
+*/
+
+#if MINIOPL3_TRACE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum TraceEventKind : uint8_t {
+    kTraceRun,
+    kTraceGenerate,
+    kTraceMidiEvent,
+    kTraceCreatePlayer,
+    kTraceReset,
+    kTraceUpdateProgram,
+    kTraceUpdateDeepVibrato,
+    kTraceUpdateDeepTremolo,
+    kTraceUpdateVolumeModel,
+    kTraceUpdateNumChips,
+    kTraceUpdateFourOps,
+    kTraceEventKindCount,
+};
+
+/**
+  A complete scope, recorded at its end, so that a full ring drops whole
+  scopes and the beginnings and ends stay balanced.
+*/
+struct TraceEvent {
+    // steady clock time of the beginning, in nanoseconds
+    uint64_t time;
+    // in nanoseconds, saturated at about 4 seconds
+    uint32_t duration;
+    // frame count, MIDI message, or chip count, depending on the kind
+    uint32_t arg;
+    uint8_t kind;
+};
+
+// steady clock time, in nanoseconds
+uint64_t traceClock() noexcept;
+
+/**
+  A single-producer single-consumer ring of trace events.
+  The audio thread records, and the collector thread reads. When the ring
+  is full, the new events are dropped and counted.
+*/
+class TraceRing {
+public:
+    TraceRing();
+    ~TraceRing();
+
+    void record(uint8_t kind, uint32_t arg, uint64_t time, uint64_t duration) noexcept;
+
+    // take the recorded events, returning how many were written in `events`
+    size_t read(TraceEvent *events, size_t maxCount) noexcept;
+    // take the count of events which were dropped
+    uint32_t takeDropped() noexcept;
+
+    unsigned id() const noexcept { return fId; }
+
+private:
+    enum { kCapacity = 1 << 13 };
+
+    TraceEvent fEvents[kCapacity];
+    // the indices are written by different threads, keep them apart
+    std::atomic<size_t> fWriteIndex{0};
+    char fPadding[64];
+    std::atomic<size_t> fReadIndex{0};
+    std::atomic<uint32_t> fDropped{0};
+    unsigned fId = 0;
+
+    TraceRing(const TraceRing &) = delete;
+    TraceRing &operator=(const TraceRing &) = delete;
+};
+
+/**
+  Records a scope, with the time of its beginning and its duration.
+*/
+class TraceScope {
+public:
+    TraceScope(TraceRing &ring, uint8_t kind, uint32_t arg = 0) noexcept
+        : fRing(ring), fKind(kind), fArg(arg), fStart(traceClock())
+    {
+    }
+
+    ~TraceScope() noexcept
+    {
+        fRing.record(fKind, fArg, fStart, traceClock() - fStart);
+    }
+
+private:
+    TraceRing &fRing;
+    uint8_t fKind;
+    uint32_t fArg;
+    uint64_t fStart;
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+#define MINIOPL3_TRACE_CONCAT_(x, y) x##y
+#define MINIOPL3_TRACE_CONCAT(x, y) MINIOPL3_TRACE_CONCAT_(x, y)
+
+#define MINIOPL3_TRACE_SCOPE(ring, ...) \
+    TraceScope MINIOPL3_TRACE_CONCAT(traceScope, __LINE__){(ring), __VA_ARGS__}
+
+#else
+
+#define MINIOPL3_TRACE_SCOPE(ring, ...) do {} while (0)
+
+#endif // MINIOPL3_TRACE
+
+// -----------------------------------------------------------------------
+
+#endif  // #ifndef TRACE_MINIOPL3_H
@@ -17,100 +17,124 @@
  */
 
 #include "ins_names.h"
-#include "ins_names_data.h"
-#include <unordered_map>
+#include <algorithm>
+#include <vector>
 
-static bool mapsInitialized = false;
-typedef std::unordered_map<uint32_t, const MidiProgram *> InstrumentMap;
-static InstrumentMap XgMap, GsMap, ScMap, Gm2Map, Gm1Map;
+// string pool, columns and sorted index, generated from ins_names_data.h by gen-ins-names
+//  - IndexIdentifiers: identifiers of the programs, and of the banks with reserved = 1
+//  - IndexSpecs, IndexRows: the spec and the program of each entry
+// the entries of an identifier are consecutive, in the order of precedence of the specs
+#include "ins_names_tables.h"
 
-static void fillInstMap(InstrumentMap &map, const MidiProgram *pgms, unsigned size)
+static const uint32_t *const indexBegin = IndexIdentifiers;
+static const uint32_t *const indexEnd = IndexIdentifiers + sizeof(IndexIdentifiers) / sizeof(*IndexIdentifiers);
+
+static const char *poolName(uint16_t name)
 {
-    map.clear();
+#if INS_NAMES_HAVE_OFFSET_TABLE
+    return &NamePool[NameOffsets[name]];
+#else
+    return &NamePool[name];
+#endif
+}
 
-    for(unsigned i = 0; i < size; ++i)
+//! Find the entry of the identifier, starting at its first entry in the index,
+//! which matches the spec with the highest precedence, or return -1
+static int findEntry(const uint32_t *it, unsigned spec)
+{
+    for(uint32_t identifier = *it; it != indexEnd && *it == identifier; ++it)
     {
-        MidiProgramId id;
-        id.percussive = pgms[i].kind == 'P';
-        id.bankMsb = pgms[i].bankMsb;
-        id.bankLsb = pgms[i].bankLsb;
-        id.program = pgms[i].program;
-        map[id.identifier] = &pgms[i];
-        // insert pseudo-entry for bank (reserved = 1, program = 0)
-        id.reserved = 1;
-        id.program = 0;
-        map.insert(InstrumentMap::value_type{id.identifier, &pgms[i]});
+        unsigned e = it - indexBegin;
+        if(spec & IndexSpecs[e])
+            return e;
     }
+    return -1;
+}
 
-    //map.shrink_to_fit();
+static void decodeProgram(unsigned row, MidiProgram *pgm)
+{
+    pgm->kind = ProgramKind[row];
+    pgm->bankMsb = ProgramBankMsb[row];
+    pgm->bankLsb = ProgramBankLsb[row];
+    pgm->program = ProgramNumber[row];
+    pgm->bankName = poolName(ProgramBankName[row]);
+    pgm->patchName = poolName(ProgramPatchName[row]);
 }
 
-const MidiProgram *getMidiProgram(MidiProgramId id, unsigned spec, unsigned *specObtained)
+bool getMidiProgram(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained)
 {
-    if(!mapsInitialized)
-    {
-        fillInstMap(XgMap, XgSet, sizeof(XgSet) / sizeof(*XgSet));
-        fillInstMap(GsMap, GsSet, sizeof(GsSet) / sizeof(*GsSet));
-        fillInstMap(ScMap, ScSet, sizeof(ScSet) / sizeof(*ScSet));
-        fillInstMap(Gm2Map, Gm2Set, sizeof(Gm2Set) / sizeof(*Gm2Set));
-        fillInstMap(Gm1Map, Gm1Set, sizeof(Gm1Set) / sizeof(*Gm1Set));
-        mapsInitialized = true;
-    }
+    int entry = -1;
 
-    struct MidiSpecToInstrumentMap
-    {
-        MidiSpec spec;
-        const InstrumentMap *map;
-    };
+    const uint32_t *it = std::lower_bound(indexBegin, indexEnd, id.identifier);
+    if(it != indexEnd && *it == id.identifier)
+        entry = findEntry(it, spec);
+
+    if(entry != -1)
+        decodeProgram(IndexRows[entry], pgm);
+
+    if(specObtained)
+        *specObtained = (entry != -1) ? IndexSpecs[entry] : (unsigned)kMidiSpecNone;
+
+    return entry != -1;
+}
 
-    const MidiSpecToInstrumentMap imaps[] =
+void getMidiPrograms(const MidiProgramId *ids, unsigned count, unsigned spec,
+                     MidiProgram *pgms, unsigned *specsObtained)
+{
+    // visit the identifiers in sorted order, to walk the index once forward
+    std::vector<unsigned> order(count);
+    for(unsigned i = 0; i < count; ++i)
     {
-        {kMidiSpecXG, &XgMap},
-        {kMidiSpecGS, &GsMap},
-        {kMidiSpecSC, &ScMap},
-        {kMidiSpecGM2, &Gm2Map},
-        {kMidiSpecGM1, &Gm1Map},
-    };
+        order[i] = i;
+        specsObtained[i] = kMidiSpecNone;
+    }
 
-    const MidiProgram *pgm = nullptr;
-    unsigned pgmspec = kMidiSpecNone;
+    std::sort(order.begin(), order.end(), [ids](unsigned a, unsigned b)
+    {
+        return ids[a].identifier < ids[b].identifier;
+    });
 
-    for(const MidiSpecToInstrumentMap &imap : imaps)
+    const uint32_t *it = indexBegin;
+    for(unsigned i : order)
     {
-        if(!(spec & imap.spec))
+        it = std::lower_bound(it, indexEnd, ids[i].identifier);
+        if(it == indexEnd)
+            break;
+        if(*it != ids[i].identifier)
             continue;
-        InstrumentMap::const_iterator it = imap.map->find(id.identifier);
-        if(it != imap.map->end())
+        int entry = findEntry(it, spec);
+        if(entry != -1)
         {
-            pgm = it->second;
-            pgmspec = imap.spec;
-            break;
+            decodeProgram(IndexRows[entry], &pgms[i]);
+            specsObtained[i] = IndexSpecs[entry];
         }
     }
-
-    if(specObtained)
-        *specObtained = pgmspec;
-
-    return pgm;
 }
 
-const MidiProgram *getFallbackProgram(MidiProgramId id, unsigned spec, unsigned *specObtained)
+bool getFallbackProgram(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained)
 {
-    const MidiProgram *pgm = nullptr;
+    bool found = false;
     if(id.percussive && (id.bankMsb != 0 || id.bankLsb != 0))
     {
         MidiProgramId fallbackId(id.identifier);
         fallbackId.bankMsb = 0;
         fallbackId.bankLsb = 0;
-        pgm = getMidiProgram(fallbackId, spec & kMidiSpecGM1, specObtained);
+        found = getMidiProgram(fallbackId, spec & kMidiSpecGM1, pgm, specObtained);
     }
+    else if(specObtained)
+        *specObtained = kMidiSpecNone;
 
-    return pgm;
+    return found;
 }
 
-const MidiProgram *getMidiBank(MidiProgramId id, unsigned spec, unsigned *specObtained)
+bool getMidiBank(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained)
 {
     id.reserved = 1;
     id.program = 0;
-    return getMidiProgram(id, spec, specObtained);
+    return getMidiProgram(id, spec, pgm, specObtained);
+}
+
+uint64_t getMidiNamesHash()
+{
+    return INS_NAMES_HASH;
 }
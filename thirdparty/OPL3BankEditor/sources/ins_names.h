@@ -21,7 +21,8 @@
 
 #include <cstdint>
 
-#pragma pack(push, 1)
+//! A program of the database, as decoded from the generated tables.
+//! It is also the type of the rows of ins_names_data.h, which they are built from.
 struct MidiProgram
 {
     //! Kind of instrument. 'M' melodic 'P' percussive
@@ -37,7 +38,6 @@ struct MidiProgram
     //! Patch name
     const char *patchName;
 };
-#pragma pack(pop)
 
 enum MidiSpec
 {
@@ -85,8 +85,19 @@ struct MidiProgramId
     };
 };
 
-const MidiProgram *getMidiProgram(MidiProgramId id, unsigned spec, unsigned *specObtained = nullptr);
-const MidiProgram *getFallbackProgram(MidiProgramId id, unsigned spec, unsigned *specObtained = nullptr);
-const MidiProgram *getMidiBank(MidiProgramId id, unsigned spec, unsigned *specObtained = nullptr);
+//! Look up a program, and return whether it is found.
+bool getMidiProgram(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained = nullptr);
+bool getFallbackProgram(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained = nullptr);
+bool getMidiBank(MidiProgramId id, unsigned spec, MidiProgram *pgm, unsigned *specObtained = nullptr);
+
+//! Look up a batch of programs, with the same results as getMidiProgram.
+//! The spec obtained is kMidiSpecNone for the programs which are not found.
+//! The lookups are safe to run concurrently, the database being immutable.
+void getMidiPrograms(const MidiProgramId *ids, unsigned count, unsigned spec,
+                     MidiProgram *pgms, unsigned *specsObtained);
+
+//! Get a hash of the content of the database, which identifies it in the
+//! caches of the data derived from it.
+uint64_t getMidiNamesHash();
 
 #endif // INSTRUMENTNAMES_H
@@ -0,0 +1,58 @@
+#include "alloc_count.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+// the global operators are replaced by counting ones, in a file of their
+// own so the compiler does not see them together with their callers
+
+static std::atomic<uint64_t> gAllocCount{0};
+static std::atomic<uint64_t> gAllocBytes{0};
+
+uint64_t allocationCount()
+{
+    return gAllocCount.load(std::memory_order_relaxed);
+}
+
+uint64_t allocationBytes()
+{
+    return gAllocBytes.load(std::memory_order_relaxed);
+}
+
+static void *countedAlloc(size_t size)
+{
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = countedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    void *ptr = countedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
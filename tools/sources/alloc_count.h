@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+// counts of the allocations done by the global operator new, since the start
+uint64_t allocationCount();
+uint64_t allocationBytes();
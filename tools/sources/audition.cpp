@@ -0,0 +1,156 @@
+#include "audition.h"
+#include "../../sources/plugin/CoreMiniOPL3.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <complex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+static const unsigned kSampleRate = 44100;
+static const unsigned kBlockSize = 512;
+static const unsigned kNoteFrames = kSampleRate / 2;
+static const unsigned kTotalFrames = kSampleRate * 3 / 4;
+static const unsigned kNote = 60;
+static const unsigned kVelocity = 100;
+
+// the spectrum is analyzed just after the attack
+static const unsigned kWindowStart = 2048;
+static const unsigned kWindowSize = 8192;
+
+static const float kSilentDb = -80;
+static const float kClippingDb = 0;
+
+static void fft(std::complex<float> *x, unsigned n)
+{
+    for (unsigned i = 1, j = 0; i < n; ++i) {
+        unsigned bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(x[i], x[j]);
+    }
+
+    for (unsigned len = 2; len <= n; len <<= 1) {
+        float angle = -2 * (float)M_PI / len;
+        std::complex<float> wlen(std::cos(angle), std::sin(angle));
+        for (unsigned i = 0; i < n; i += len) {
+            std::complex<float> w(1);
+            for (unsigned j = 0; j < len / 2; ++j) {
+                std::complex<float> u = x[i + j];
+                std::complex<float> v = x[i + j + len / 2] * w;
+                x[i + j] = u + v;
+                x[i + j + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+}
+
+void auditionPreset(const int values[], AuditionResult &result)
+{
+    result = AuditionResult{};
+
+    float params[paramCount];
+    for (unsigned i = 0; i < paramCount; ++i)
+        params[i] = values[i];
+    params[paramNumChips] = 1;
+
+    CoreMiniOPL3 core;
+    core.setSampleRate(kSampleRate);
+    core.setEmulator(ADLMIDI_EMU_DOSBOX);
+    core.setParameterValues(params);
+    core.activate();
+
+    std::unique_ptr<float[]> buffer{new float[2 * kBlockSize]};
+    float *outputs[] = {&buffer[0], &buffer[kBlockSize]};
+    std::vector<float> mono(kTotalFrames);
+
+    for (unsigned frame = 0; frame < kTotalFrames; frame += kBlockSize) {
+        unsigned frames = kBlockSize;
+        if (frames > kTotalFrames - frame)
+            frames = kTotalFrames - frame;
+
+        MidiEvent event = {};
+        unsigned eventCount = 0;
+        if (frame == 0) {
+            event.size = 3;
+            event.data[0] = 0x90;
+            event.data[1] = kNote;
+            event.data[2] = kVelocity;
+            eventCount = 1;
+        }
+        else if (frame <= kNoteFrames && kNoteFrames < frame + frames) {
+            event.frame = kNoteFrames - frame;
+            event.size = 3;
+            event.data[0] = 0x80;
+            event.data[1] = kNote;
+            event.data[2] = 0;
+            eventCount = 1;
+        }
+
+        core.run(outputs, frames, &event, eventCount);
+
+        for (unsigned i = 0; i < frames; ++i)
+            mono[frame + i] = 0.5f * (outputs[0][i] + outputs[1][i]);
+    }
+
+    // level
+    float peak = 0;
+    for (unsigned i = 0; i < kTotalFrames; ++i)
+        peak = std::max(peak, std::fabs(mono[i]));
+
+    result.peakDb = (peak > 0) ? (20 * std::log10(peak)) : -200;
+    result.silent = result.peakDb < kSilentDb;
+    result.clipping = result.peakDb >= kClippingDb;
+
+    if (result.silent)
+        return;
+
+    // spectrum, with a Hann window
+    std::vector<std::complex<float>> spectrum(kWindowSize);
+    for (unsigned i = 0; i < kWindowSize; ++i) {
+        float w = 0.5f * (1 - std::cos(2 * (float)M_PI * i / (kWindowSize - 1)));
+        spectrum[i] = w * mono[kWindowStart + i];
+    }
+    fft(spectrum.data(), kWindowSize);
+
+    // energy in logarithmic bands from 50 Hz to 16 kHz
+    double energy[kAuditionBands] = {};
+    const double fmin = 50, fmax = 16000;
+    for (unsigned k = 1; k < kWindowSize / 2; ++k) {
+        double f = (double)k * kSampleRate / kWindowSize;
+        if (f < fmin || f >= fmax)
+            continue;
+        unsigned band = (unsigned)(kAuditionBands * std::log(f / fmin) / std::log(fmax / fmin));
+        energy[band] += std::norm(spectrum[k]);
+    }
+
+    double maxEnergy = 0;
+    for (unsigned b = 0; b < kAuditionBands; ++b)
+        maxEnergy = std::max(maxEnergy, energy[b]);
+
+    for (unsigned b = 0; b < kAuditionBands; ++b) {
+        double db = (energy[b] > 0 && maxEnergy > 0) ?
+            (10 * std::log10(energy[b] / maxEnergy)) : -200;
+        int level = 15 + (int)std::floor(db / 4);
+        result.bands[b] = (level < 0) ? 0 : level;
+    }
+}
+
+void appendFingerprint(std::string &out, const AuditionResult &result)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (unsigned b = 0; b < kAuditionBands; ++b)
+        out.push_back(hex[result.bands[b]]);
+}
+
+unsigned fingerprintDistance(const AuditionResult &a, const AuditionResult &b)
+{
+    unsigned distance = 0;
+    for (unsigned i = 0; i < kAuditionBands; ++i)
+        distance += std::abs((int)a.bands[i] - (int)b.bands[i]);
+    return distance;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+//
+enum {
+    kAuditionBands = 16,
+};
+
+struct AuditionResult {
+    // peak amplitude of the note, in decibels
+    float peakDb = -200;
+    // energy of the logarithmic bands, 0 to 15 in steps of 4 dB below the strongest
+    uint8_t bands[kAuditionBands] = {};
+    bool silent = false;
+    bool clipping = false;
+};
+
+// render a short note of the preset, and analyze it
+void auditionPreset(const int values[], AuditionResult &result);
+
+//
+void appendFingerprint(std::string &out, const AuditionResult &result);
+unsigned fingerprintDistance(const AuditionResult &a, const AuditionResult &b);
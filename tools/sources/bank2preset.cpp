@@ -1,257 +1,868 @@
 #include "bank2preset.h"
-#include "../../sources/plugin/SharedMiniOPL3.cpp"
-#include "../thirdparty/libADLMIDI/src/wopl/wopl_file.c"
 #include <getopt.h>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#   include <io.h>
+#   include <direct.h>
+#   include <process.h>
+#else
+#   include <unistd.h>
+#endif
+#if defined(BANK2PRESET_HAVE_MMAP)
+#   include <sys/mman.h>
+#endif
+#if !defined(O_BINARY)
+#   define O_BINARY 0
+#endif
+#if !defined(STDIN_FILENO)
+#   define STDIN_FILENO 0
+#endif
+#if !defined(STDOUT_FILENO)
+#   define STDOUT_FILENO 1
+#endif
 
+static writeHeaderFn gWriteHeader = nullptr;
+static writeBankFn gWriteBank = nullptr;
 static writeInstrumentFn gWriteInst = &writeInstrumentAsCpp;
 static const char *gLv2UriPrefix = "";
-static bool gLv2HeaderWritten = false;
-static std::unordered_map<std::string, size_t> gLv2BanksKnown;
-static Parameter gParameters[paramCount];
+static bool gDeduplicate = false;
+static const char *gBundleDir = nullptr;
+static unsigned gLv2Split = kSplitNone;
+static unsigned gLv2SplitCount = 0;
+static const char *gCacheDir = nullptr;
+static uint64_t gConversionHash = 0;
+static std::atomic<unsigned> gCacheTempCounter{0};
+static const char *gStreamList = nullptr;
+static const char *gAuditionReport = nullptr;
+static bool gOmitSilent = false;
+static bool gWriteWoplFields = false;
 
 int main(int argc, char *argv[])
 {
-    for (int c; (c = getopt(argc, argv, "L:M:")) != -1;) {
+    unsigned numThreads = std::thread::hardware_concurrency();
+
+    for (int c; (c = getopt(argc, argv, "L:M:j:db:u:S:C:s:A:Xw")) != -1;) {
         switch (c) {
         case 'L':
+            gWriteHeader = &writeHeaderAsLv2Ttl;
+            gWriteBank = &writeBankAsLv2PresetTtl;
             gWriteInst = &writeInstrumentAsLv2PresetTtl;
             gLv2UriPrefix = optarg;
             break;
         case 'M':
+            gWriteHeader = &writeHeaderAsLv2Ttl;
+            gWriteBank = &writeBankAsLv2ManTtl;
             gWriteInst = &writeInstrumentAsLv2ManTtl;
             gLv2UriPrefix = optarg;
             break;
+        case 'j':
+            numThreads = std::atoi(optarg);
+            break;
+        case 'd':
+            gDeduplicate = true;
+            break;
+        case 'b':
+            gBundleDir = optarg;
+            break;
+        case 'u':
+            gLv2UriPrefix = optarg;
+            break;
+        case 'S':
+            if (!strcmp(optarg, "bank"))
+                gLv2Split = kSplitPerBank;
+            else {
+                gLv2Split = kSplitPerCount;
+                gLv2SplitCount = std::atoi(optarg);
+                if (gLv2SplitCount < 1) {
+                    fprintf(stderr, "Invalid split argument.\n");
+                    return 1;
+                }
+            }
+            break;
+        case 'C':
+            gCacheDir = optarg;
+            break;
+        case 's':
+            gStreamList = optarg;
+            break;
+        case 'A':
+            gAuditionReport = optarg;
+            break;
+        case 'X':
+            gOmitSilent = true;
+            break;
+        case 'w':
+            gWriteWoplFields = true;
+            break;
         default:
             return 1;
         }
     }
 
+    if (numThreads < 1)
+        numThreads = 1;
+
+    if (gLv2Split != kSplitNone && !gBundleDir) {
+        fprintf(stderr, "Splitting the presets requires a bundle directory.\n");
+        return 1;
+    }
+
+    if (gDeduplicate && gWriteWoplFields && !gBundleDir && gWriteInst == &writeInstrumentAsCpp) {
+        fprintf(stderr, "The default format cannot refer to the duplicates with their WOPL fields.\n");
+        return 1;
+    }
+
+    if (gStreamList && (gBundleDir || gDeduplicate || gAuditionReport || gOmitSilent)) {
+        fprintf(stderr, "The streaming mode cannot write bundles, deduplicate or audition.\n");
+        return 1;
+    }
+
     unsigned numfiles = argc - optind;
-    if (numfiles == 0) {
+    if (numfiles == 0 && !gStreamList) {
         fprintf(stderr, "No bank file has been specified.\n");
         return 1;
     }
+    if (numfiles > 0 && gStreamList) {
+        fprintf(stderr, "The bank files are given by the list in streaming mode.\n");
+        return 1;
+    }
 
-    for (unsigned i = 0; i < paramCount; ++i)
-        InitParameter(i, gParameters[i]);
+    if (gCacheDir && !makeDirectories(gCacheDir)) {
+        fprintf(stderr, "Cannot create the cache directory.\n");
+        return 1;
+    }
+    if (gCacheDir)
+        gConversionHash = hashConversion();
 
-    std::vector<WOPLFile_u> files{numfiles};
-    std::vector<std::string> names{numfiles};
+    if (gStreamList)
+        return runStreaming(gStreamList) ? 0 : 1;
 
-    for (unsigned i = 0; i < numfiles; ++i) {
-        std::string &name = names[i];
-        name = argv[optind + i];
+    std::vector<BankJob> jobs{numfiles};
 
-        WOPLFile_u wopl{WOPL_LoadBankFromFile(name.c_str())};
-        if (!wopl) {
-            fprintf(stderr, "Cannot load the bank file in WOPL format.\n");
-            return 1;
-        }
+    // load and convert the banks, or get them from the cache
+    std::atomic<bool> loadError{false};
+    parallelFor(numfiles, numThreads, [&](size_t i) {
+        BankJob &job = jobs[i];
+        job.filepath = argv[optind + i];
+        job.name = bankNameOfPath(job.filepath);
 
-        size_t pos = name.rfind('/');
-        if (pos != name.npos)
-            name = name.substr(pos + 1);
-        if (name.size() >= 5 && !memcmp(name.data() + name.size() - 5, ".wopl", 5))
-            name.resize(name.size() - 5);
+        if (!loadBank(job))
+            loadError = true;
+    });
 
-        files[i] = std::move(wopl);
+    if (loadError) {
+        fprintf(stderr, "Cannot load the bank file in WOPL format.\n");
+        return 1;
     }
 
-    std::vector<Ins> instlist;
+    // render the instruments, and leave out the silent ones if requested;
+    // they keep their numbers, so the others have the same URIs with -X
+    if (gAuditionReport || gOmitSilent) {
+        auditionAllPresets(jobs, numThreads);
+
+        if (gOmitSilent) {
+            for (BankJob &job : jobs) {
+                for (Preset &preset : job.presets)
+                    preset.omitted = preset.audition.silent;
+            }
+        }
+    }
+
+    // number the banks and the instruments, in order of the arguments
+    std::unordered_map<std::string, unsigned> banksKnown;
+    size_t numInstruments = 0;
     for (unsigned i = 0; i < numfiles; ++i)
-        extractAllInstruments(*files[i], names[i].c_str(), instlist);
+        numberBank(jobs[i], banksKnown, numInstruments);
+
+    // identify the MIDI spec, using the instruments of all the banks
+    MidiSpecCount specCount;
+    for (const BankJob &job : jobs) {
+        specCount.numGS += job.specCount.numGS;
+        specCount.numXG += job.specCount.numXG;
+    }
+    unsigned spec = identifyMidiSpec(specCount);
+
+    // name the instruments which do not have a name
+    parallelFor(numfiles, numThreads, [&](size_t i) {
+        nameInstruments(jobs[i].presets, spec);
+    });
+
+    if (gAuditionReport && !writeAuditionReport(gAuditionReport, jobs)) {
+        fprintf(stderr, "Cannot write the audition report.\n");
+        return 1;
+    }
 
-    convertInstrumentList(instlist);
+    // identify the duplicates, the first occurrence being canonical
+    if (gDeduplicate) {
+        std::unordered_map<const int *, Preset *, PresetValuesHash, PresetValuesEqual> presetsKnown;
+        presetsKnown.reserve(numInstruments);
+        for (BankJob &job : jobs) {
+            for (Preset &preset : job.presets) {
+                if (preset.omitted)
+                    continue;
+                auto presetInsert = presetsKnown.insert(
+                    std::pair<const int *, Preset *>{preset.values, &preset});
+                if (!presetInsert.second) {
+                    Preset *canonical = presetInsert.first->second;
+                    preset.duplicateOf = canonical;
+                    canonical->aliases.push_back(&preset);
+                }
+            }
+        }
+    }
+
+    if (gBundleDir)
+        return writeBundle(gBundleDir, jobs, numInstruments, numThreads) ? 0 : 1;
+
+    // write each bank into its own buffer
+    parallelFor(numfiles, numThreads, [&](size_t i) {
+        writeBank(jobs[i].output, jobs[i]);
+    });
+
+    // join the buffers in order of the arguments, and write them at once
+    std::string output;
+    if (numInstruments > 0 && gWriteHeader)
+        gWriteHeader(output);
+
+    size_t outputSize = output.size();
+    for (const BankJob &job : jobs)
+        outputSize += job.output.size();
+    output.reserve(outputSize);
+
+    for (BankJob &job : jobs) {
+        output.append(job.output);
+        std::string().swap(job.output);
+    }
+
+#if defined(_WIN32)
+    _setmode(STDOUT_FILENO, _O_BINARY);
+#endif
+    if (!writeAll(STDOUT_FILENO, output.data(), output.size())) {
+        fprintf(stderr, "Cannot write the output.\n");
+        return 1;
+    }
 
     return 0;
 }
 
-void convertInstrumentList(const std::vector<Ins> &instlist)
+void auditionAllPresets(std::vector<BankJob> &jobs, unsigned numThreads)
 {
-    unsigned spec = identifyMidiSpec(instlist);
+    std::vector<Preset *> presets;
+    for (BankJob &job : jobs) {
+        for (Preset &preset : job.presets)
+            presets.push_back(&preset);
+    }
+
+    if (presets.empty())
+        return;
+
+    // the first rendering initializes the tables of the emulator
+    auditionPreset(presets[0]->values, presets[0]->audition);
+
+    parallelFor(presets.size() - 1, numThreads, [&](size_t i) {
+        Preset &preset = *presets[i + 1];
+        auditionPreset(preset.values, preset.audition);
+    });
+}
 
-    for (size_t index = 0, count = instlist.size(); index < count; ++index) {
-        const Ins &ins = instlist[index];
-        convertInstrument(index, ins, spec);
+bool writeAuditionReport(const char *filepath, const std::vector<BankJob> &jobs)
+{
+    std::vector<const Preset *> presets;
+    for (const BankJob &job : jobs) {
+        for (const Preset &preset : job.presets)
+            presets.push_back(&preset);
     }
+
+    std::string out;
+    out.append("# preset\tbank\tname\tpeak\tfingerprint\tflags\n");
+
+    for (size_t i = 0, n = presets.size(); i < n; ++i) {
+        const Preset &preset = *presets[i];
+        const AuditionResult &audition = preset.audition;
+
+        appendUnsigned(out, preset.index, 4);
+        out.push_back('\t');
+        appendTsvField(out, preset.bankName);
+        out.push_back('\t');
+        appendTsvField(out, preset.name.c_str());
+        out.push_back('\t');
+        appendInteger(out, (int)std::lround(audition.peakDb));
+        out.push_back('\t');
+        appendFingerprint(out, audition);
+        out.push_back('\t');
+
+        size_t flagsStart = out.size();
+        auto addFlag = [&out, flagsStart](const char *flag) {
+            if (out.size() > flagsStart)
+                out.push_back(',');
+            out.append(flag);
+        };
+
+        if (audition.silent)
+            addFlag("silent");
+        if (audition.clipping)
+            addFlag("clipping");
+
+        // the first earlier preset which sounds nearly the same
+        for (size_t j = 0; j < i && !audition.silent; ++j) {
+            const AuditionResult &other = presets[j]->audition;
+            if (!other.silent && std::fabs(audition.peakDb - other.peakDb) < 1.0f &&
+                fingerprintDistance(audition, other) <= kSimilarDistance) {
+                addFlag("similar:");
+                appendUnsigned(out, presets[j]->index, 4);
+                break;
+            }
+        }
+
+        if (out.size() == flagsStart)
+            out.push_back('-');
+        out.push_back('\n');
+    }
+
+    return writeFile(filepath, out);
 }
 
-void convertInstrument(unsigned index, const Ins &ins, unsigned spec)
+bool runStreaming(const char *listpath)
 {
-    const WOPLFile &file = *ins.file;
-    const WOPLInstrument &inst = ins.bank->ins[ins.program_number];
+    FILE_u listFile;
+    FILE *list = stdin;
+    if (strcmp(listpath, "-")) {
+        listFile.reset(fopen(listpath, "r"));
+        if (!listFile) {
+            fprintf(stderr, "Cannot open the list of bank files.\n");
+            return false;
+        }
+        list = listFile.get();
+    }
+
+#if defined(_WIN32)
+    _setmode(STDOUT_FILENO, _O_BINARY);
+#endif
+
+    std::unordered_map<std::string, unsigned> banksKnown;
+    size_t numInstruments = 0;
+    bool headerWritten = false;
+
+    // one bank at a time: load, convert, write, and free
+    for (std::string line; readLine(list, line);) {
+        while (!line.empty() && std::isspace((unsigned char)line.back()))
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        BankJob job;
+        job.filepath = line;
+        job.name = bankNameOfPath(job.filepath);
+
+        if (!loadBank(job)) {
+            fprintf(stderr, "Cannot load the bank file in WOPL format: %s\n", job.filepath.c_str());
+            return false;
+        }
+
+        numberBank(job, banksKnown, numInstruments);
+
+        // the MIDI spec is identified with the instruments of this bank only
+        unsigned spec = identifyMidiSpec(job.specCount);
+        nameInstruments(job.presets, spec);
+
+        std::string &output = job.output;
+        if (!job.presets.empty() && !headerWritten) {
+            if (gWriteHeader)
+                gWriteHeader(output);
+            headerWritten = true;
+        }
+        writeBank(output, job);
+
+        if (!writeAll(STDOUT_FILENO, output.data(), output.size())) {
+            fprintf(stderr, "Cannot write the output.\n");
+            return false;
+        }
+    }
+
+    if (ferror(list)) {
+        fprintf(stderr, "Cannot read the list of bank files.\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool readLine(FILE *fh, std::string &line)
+{
+    line.clear();
+    for (int c; (c = getc(fh)) != EOF;) {
+        if (c == '\n')
+            return true;
+        line.push_back((char)c);
+    }
+    return !line.empty();
+}
+
+std::string bankNameOfPath(const std::string &path)
+{
+    std::string name = (path == "-") ? "stdin" : path;
+    size_t pos = name.rfind('/');
+    if (pos != name.npos)
+        name = name.substr(pos + 1);
+    if (name.size() >= 5 && !memcmp(name.data() + name.size() - 5, ".wopl", 5))
+        name.resize(name.size() - 5);
+    return name;
+}
+
+void numberBank(BankJob &job, std::unordered_map<std::string, unsigned> &banksKnown, size_t &numInstruments)
+{
+    job.firstIndex = numInstruments;
+    numInstruments += job.presets.size();
+
+    if (job.presets.empty())
+        return;
+
+    auto bankInsert = banksKnown.insert(
+        std::pair<std::string, unsigned>{job.name, banksKnown.size()});
+    job.bankno = bankInsert.first->second;
+    job.writesBank = bankInsert.second;
+
+    for (size_t index = 0, count = job.presets.size(); index < count; ++index) {
+        Preset &preset = job.presets[index];
+        preset.index = job.firstIndex + index;
+        preset.bankno = job.bankno;
+        preset.bankName = job.name.c_str();
+    }
+}
+
+void writeBank(std::string &out, const BankJob &job)
+{
+    if (job.writesBank && gWriteBank)
+        gWriteBank(out, job);
+    for (const Preset &preset : job.presets) {
+        if (!preset.omitted)
+            gWriteInst(out, preset);
+    }
+}
+
+bool writeBundle(const char *dir, std::vector<BankJob> &jobs, size_t numInstruments, unsigned numThreads)
+{
+    // write the manifest and the documents of presets of each bank
+    parallelFor(jobs.size(), numThreads, [&](size_t i) {
+        BankJob &job = jobs[i];
+        if (job.writesBank) {
+            writeBankAsLv2ManTtl(job.output, job);
+            writeBankAsLv2PresetTtl(documentOutput(job, lv2DocumentName(job.bankno, job.firstIndex)), job);
+        }
+        for (const Preset &preset : job.presets) {
+            if (preset.omitted)
+                continue;
+            writeInstrumentAsLv2ManTtl(job.output, preset);
+            writeInstrumentAsLv2PresetTtl(documentOutput(job, lv2DocumentName(preset.bankno, preset.index)), preset);
+        }
+    });
+
+    // join the pieces of each document in order of the arguments
+    std::string manifest;
+    if (numInstruments > 0)
+        writeHeaderAsLv2Ttl(manifest);
+    std::vector<std::pair<std::string, std::string>> documents;
+    std::unordered_map<std::string, size_t> documentsKnown;
+
+    for (BankJob &job : jobs) {
+        manifest.append(job.output);
+        std::string().swap(job.output);
+
+        for (std::pair<std::string, std::string> &piece : job.documents) {
+            auto documentInsert = documentsKnown.insert(
+                std::pair<std::string, size_t>{piece.first, documents.size()});
+            if (documentInsert.second) {
+                documents.emplace_back(piece.first, std::string{});
+                writeHeaderAsLv2Ttl(documents.back().second);
+            }
+            documents[documentInsert.first->second].second.append(piece.second);
+        }
+        job.documents.clear();
+    }
+
+    // write the files of the bundle
+    if (!makeDirectories(dir)) {
+        fprintf(stderr, "Cannot create the bundle directory.\n");
+        return false;
+    }
+
+    if (!writeFile((std::string(dir) + "/manifest.ttl").c_str(), manifest)) {
+        fprintf(stderr, "Cannot write the manifest.\n");
+        return false;
+    }
+
+    for (const std::pair<std::string, std::string> &document : documents) {
+        if (!writeFile((std::string(dir) + '/' + document.first).c_str(), document.second)) {
+            fprintf(stderr, "Cannot write the presets document.\n");
+            return false;
+        }
+    }
 
-    unsigned algorithm = inst.fb_conn1_C0 & 1;
+    return true;
+}
+
+std::string lv2DocumentName(unsigned bankno, unsigned index)
+{
+    std::string name;
+    switch (gLv2Split) {
+    default:
+        name = "presets";
+        break;
+    case kSplitPerBank:
+        name = "bank";
+        appendUnsigned(name, bankno, 4);
+        break;
+    case kSplitPerCount:
+        name = "presets";
+        appendUnsigned(name, index / gLv2SplitCount, 4);
+        break;
+    }
+    name.append(".ttl");
+    return name;
+}
+
+std::string &documentOutput(BankJob &job, const std::string &docname)
+{
+    // the presets come in order, so the document is usually the last one
+    for (size_t i = job.documents.size(); i-- > 0;) {
+        if (job.documents[i].first == docname)
+            return job.documents[i].second;
+    }
+    job.documents.emplace_back(docname, std::string{});
+    return job.documents.back().second;
+}
+
+bool loadBank(BankJob &job)
+{
+    FileData data;
+    if (!data.load(job.filepath.c_str()))
+        return false;
 
-    if (inst.inst_flags & WOPL_Ins_4op) {
-        algorithm |= (inst.fb_conn2_C0 & 1) << 1;
-        algorithm += 2;
-        if (inst.inst_flags & WOPL_Ins_Pseudo4op)
-            algorithm += 4;
+    std::string cachePath;
+    if (gCacheDir) {
+        cachePath.append(gCacheDir);
+        cachePath.push_back('/');
+        // the bank, and everything which its conversion depends on
+        appendHex(cachePath, hashBytes(data.data(), data.size(), gConversionHash), 16);
+        cachePath.append(".cache");
+        if (loadCachedBank(cachePath.c_str(), job))
+            return true;
     }
 
-    int values[paramCount];
+    WOPLFile_u file{WOPL_LoadBankFromMem(const_cast<uint8_t *>(data.data()), data.size(), nullptr)};
+    if (!file)
+        return false;
+
+    std::vector<Ins> instlist;
+    extractAllInstruments(*file, instlist);
+    convertInstrumentList(instlist, job.presets);
+    job.specCount = countMidiSpecs(job.presets);
+
+    if (gCacheDir && !storeCachedBank(cachePath.c_str(), job))
+        fprintf(stderr, "Cannot write the cache file of \"%s\".\n", job.filepath.c_str());
+
+    return true;
+}
+
+void convertInstrumentList(const std::vector<Ins> &instlist, std::vector<Preset> &presets)
+{
+    presets.resize(instlist.size());
+    for (size_t index = 0, count = instlist.size(); index < count; ++index)
+        convertInstrument(instlist[index], presets[index]);
+}
+
+void convertInstrument(const Ins &ins, Preset &preset)
+{
+    const WOPLFile &file = *ins.file;
+    const WOPLInstrument &inst = ins.bank->ins[ins.program_number];
+
+    preset.id = MidiProgramId{ins.isdrum, ins.bank->bank_midi_msb, ins.bank->bank_midi_lsb, ins.program_number};
+
+    int *values = preset.values;
     for (unsigned i = 0; i < paramCount; ++i)
-        values[i] = gParameters[i].ranges.def;
+        values[i] = ParameterInfos[i].def;
 
-    std::string name = inst.inst_name;
+    std::string &name = preset.name;
+    name = inst.inst_name;
     while (!name.empty() && std::isspace((unsigned char)name.back()))
         name.pop_back();
+    preset.named = !name.empty();
 
-    if (name.empty()) {
-        // look it up in MIDI DB
-        MidiProgramId id{ins.isdrum, ins.bank->bank_midi_msb, ins.bank->bank_midi_lsb, ins.program_number};
-        const MidiProgram *pgm = getMidiProgram(id, spec);
-        if (!pgm)
-            pgm = getFallbackProgram(id, spec);
-        if (pgm)
-            name = pgm->patchName;
-    }
-
-    values[paramAlgorithm] = algorithm;
-    values[paramFeedback1] = inst.fb_conn1_C0 >> 1;
-    values[paramFeedback2] = inst.fb_conn2_C0 >> 1;
-    values[paramTranspose1] = inst.note_offset1;
-    values[paramTranspose2] = inst.note_offset2;
-    values[paramFineTune2] = inst.second_voice_detune;
-    values[paramVelOffset] = inst.midi_velocity_offset;
-
-    const WOPLOperator *op1234[] = {
-        &inst.operators[1],
-        &inst.operators[0],
-        &inst.operators[3],
-        &inst.operators[2],
-    };
+    // the flags which are not decoded into the algorithm, like the rhythm mode
+    preset.percussionKey = inst.percussion_key_number;
+    preset.flags = inst.inst_flags & ~(kInstrumentFlag4op|kInstrumentFlagPseudo4op|WOPL_Ins_IsBlank);
+    preset.delayOnMs = inst.delay_on_ms;
+    preset.delayOffMs = inst.delay_off_ms;
 
-    for (unsigned o = 0; o < 4; ++o) {
-        const WOPLOperator &op = *op1234[o];
-        int *opParams = values + o * (paramOp2Attack - paramOp1Attack);
-        opParams[paramOp1Attack] = op.atdec_60 >> 4;
-        opParams[paramOp1Decay] = op.atdec_60 & 15;
-        opParams[paramOp1Sustain] = 15 - (op.susrel_80 >> 4);
-        opParams[paramOp1Release] = op.susrel_80 & 15;
-        opParams[paramOp1Wave] = op.waveform_E0 & 7;
-        opParams[paramOp1Fmul] = op.avekf_20 & 15;
-        opParams[paramOp1Level] = 63 - (op.ksl_l_40 & 63);
-        opParams[paramOp1KSL] = op.ksl_l_40 >> 6;
-        opParams[paramOp1Vib] = (op.avekf_20 >> 6) & 1;
-        opParams[paramOp1Am] = (op.avekf_20 >> 7) & 1;
-        opParams[paramOp1Eg] = (op.avekf_20 >> 5) & 1;
-        opParams[paramOp1KSR] = (op.avekf_20 >> 4) & 1;
-    }
+    for (unsigned i = paramAlgorithm; i < paramCount; ++i)
+        values[i] = GetInstrumentParameter(inst, i);
 
     values[paramDeepVibrato] = (file.opl_flags & WOPL_FLAG_DEEP_VIBRATO) != 0;
     values[paramDeepTremolo] = (file.opl_flags & WOPL_FLAG_DEEP_TREMOLO) != 0;
     values[paramVolumeModel] = file.volume_model;
-
-    gWriteInst(index, ins, name.c_str(), values);
 }
 
-void writeInstrumentAsCpp(unsigned index, const Ins &ins, const char *name, const int values[])
+void nameInstruments(std::vector<Preset> &presets, unsigned spec)
 {
-    (void)index;
-    (void)ins;
+    std::vector<Preset *> unnamed;
+    std::vector<MidiProgramId> ids;
+    for (Preset &preset : presets) {
+        if (preset.name.empty()) {
+            unnamed.push_back(&preset);
+            ids.push_back(preset.id);
+        }
+    }
 
-    printf("{\"%s\", {", name);
-    for (unsigned i = 0; i < paramCount; ++i) {
-        if (i > 0) printf(",");
-        printf("%d", values[i]);
+    // look them up in MIDI DB
+    std::vector<MidiProgram> pgms(ids.size());
+    std::vector<unsigned> specs(ids.size());
+    getMidiPrograms(ids.data(), ids.size(), spec, pgms.data(), specs.data());
+
+    for (size_t i = 0, n = unnamed.size(); i < n; ++i) {
+        if (specs[i] != kMidiSpecNone || getFallbackProgram(ids[i], spec, &pgms[i]))
+            unnamed[i]->name = pgms[i].patchName;
     }
-    printf("}},\n");
 }
 
-void writeInstrumentAsLv2ManTtl(unsigned index, const Ins &ins, const char *name, const int values[])
+const char *const kWoplFieldNames[kWoplFieldCount] = {
+    "percussive",
+    "bankMsb",
+    "bankLsb",
+    "program",
+    "percussionKey",
+    "flags",
+    "delayOn",
+    "delayOff",
+    "named",
+};
+
+void getWoplFields(const Preset &preset, unsigned fields[kWoplFieldCount])
 {
-    (void)ins;
-    (void)name;
-    (void)values;
+    fields[0] = preset.id.percussive;
+    fields[1] = preset.id.bankMsb;
+    fields[2] = preset.id.bankLsb;
+    fields[3] = preset.id.program;
+    fields[4] = preset.percussionKey;
+    fields[5] = preset.flags;
+    fields[6] = preset.delayOnMs;
+    fields[7] = preset.delayOffMs;
+    fields[8] = preset.named;
+}
 
-    if (!gLv2HeaderWritten) {
-        printf(
-            "@prefix syn:  <%s> ." "\n"
-            "\n"
-            "@prefix lv2:  <http://lv2plug.in/ns/lv2core#> ." "\n"
-            "@prefix pset: <http://lv2plug.in/ns/ext/presets#> ." "\n"
-            "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> ." "\n",
-            gLv2UriPrefix);
-        gLv2HeaderWritten = true;
-    }
+void writeHeaderAsLv2Ttl(std::string &out)
+{
+    out.append(
+        "@prefix syn:  <");
+    out.append(gLv2UriPrefix);
+    out.append(
+        "> ." "\n"
+        "\n"
+        "@prefix lv2:  <http://lv2plug.in/ns/lv2core#> ." "\n"
+        "@prefix pset: <http://lv2plug.in/ns/ext/presets#> ." "\n"
+        "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> ." "\n");
+    if (gWriteWoplFields)
+        out.append(
+            "@prefix wopl: <" DISTRHO_PLUGIN_URI "/wopl#> ." "\n");
+}
 
-    auto bankInsert = gLv2BanksKnown.insert(
-        std::pair<std::string, size_t>{ins.filename, gLv2BanksKnown.size()});
-    unsigned bankno = bankInsert.first->second;
+void writeBankAsLv2ManTtl(std::string &out, const BankJob &job)
+{
+    out.append(
+        "\n"
+        "syn:bank");
+    appendUnsigned(out, job.bankno, 4);
+    out.append(
+        "\n"
+        "\t" "a pset:Bank ;" "\n"
+        "\t" "lv2:appliesTo <" DISTRHO_PLUGIN_URI "> ;" "\n"
+        "\t" "rdfs:seeAlso <");
+    out.append(lv2DocumentName(job.bankno, job.firstIndex));
+    out.append(
+        "> .\n");
+}
 
-    if (bankInsert.second) {
-        printf(
-            "\n"
-            "syn:bank%04u" "\n"
-            "\t" "a pset:Bank ;" "\n"
-            "\t" "lv2:appliesTo <%s> ;" "\n"
-            "\t" "rdfs:seeAlso <presets.ttl> .\n",
-            bankno, DISTRHO_PLUGIN_URI);
+void writeBankAsLv2PresetTtl(std::string &out, const BankJob &job)
+{
+    out.append(
+        "\n"
+        "syn:bank");
+    appendUnsigned(out, job.bankno, 4);
+    out.append(
+        "\n"
+        "\t" "rdfs:label ");
+    appendTtlString(out, job.name.c_str());
+    out.append(
+        " ." "\n");
+}
+
+void writeInstrumentAsCpp(std::string &out, const Preset &preset)
+{
+    if (preset.duplicateOf) {
+        out.append("// ");
+        appendCString(out, preset.name.c_str());
+        out.append(" is a duplicate of ");
+        appendCString(out, preset.duplicateOf->name.c_str());
+        out.push_back('\n');
+        return;
     }
 
-    printf(
+    out.push_back('{');
+    appendCString(out, preset.name.c_str());
+    out.append(", {");
+    for (unsigned i = 0; i < paramCount; ++i) {
+        if (i > 0) out.push_back(',');
+        appendInteger(out, preset.values[i]);
+    }
+    out.append("}},");
+    if (gWriteWoplFields) {
+        unsigned fields[kWoplFieldCount];
+        getWoplFields(preset, fields);
+        out.append(" // wopl");
+        for (unsigned i = 0; i < kWoplFieldCount; ++i) {
+            out.push_back(' ');
+            out.append(kWoplFieldNames[i]);
+            out.push_back('=');
+            appendUnsigned(out, fields[i]);
+        }
+    }
+    out.push_back('\n');
+}
+
+void writeInstrumentAsLv2ManTtl(std::string &out, const Preset &preset)
+{
+    if (preset.duplicateOf)
+        return;
+
+    out.append(
+        "\n"
+        "syn:preset");
+    appendUnsigned(out, preset.index, 4);
+    out.append(
         "\n"
-        "syn:preset%04u" "\n"
         "\t" "a pset:Preset ;" "\n"
-        "\t" "lv2:appliesTo <%s> ;" "\n"
-        "\t" "rdfs:seeAlso <presets.ttl> .\n",
-        index, DISTRHO_PLUGIN_URI);
+        "\t" "lv2:appliesTo <" DISTRHO_PLUGIN_URI "> ;" "\n"
+        "\t" "rdfs:seeAlso <");
+    out.append(lv2DocumentName(preset.bankno, preset.index));
+    out.append(
+        "> .\n");
 }
 
-void writeInstrumentAsLv2PresetTtl(unsigned index, const Ins &ins, const char *name, const int values[])
+void writeInstrumentAsLv2PresetTtl(std::string &out, const Preset &preset)
 {
-    (void)ins;
-
-    if (!gLv2HeaderWritten) {
-        printf(
-            "@prefix syn:  <%s> ." "\n"
-            "\n"
-            "@prefix lv2:  <http://lv2plug.in/ns/lv2core#> ." "\n"
-            "@prefix pset: <http://lv2plug.in/ns/ext/presets#> ." "\n"
-            "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> ." "\n",
-            gLv2UriPrefix);
-        gLv2HeaderWritten = true;
+    if (preset.duplicateOf) {
+        if (gWriteWoplFields)
+            writeDuplicateAsLv2PresetTtl(out, preset);
+        return;
     }
 
-    auto bankInsert = gLv2BanksKnown.insert(
-        std::pair<std::string, size_t>{ins.filename, gLv2BanksKnown.size()});
-    unsigned bankno = bankInsert.first->second;
+    out.append(
+        "\n"
+        "syn:preset");
+    appendUnsigned(out, preset.index, 4);
+    out.append(
+        "\n"
+        "\t" "rdfs:label ");
+    appendTtlString(out, preset.name.c_str());
+    out.append(
+        " ;" "\n"
+        "\t" "pset:bank syn:bank");
+    appendUnsigned(out, preset.bankno, 4);
+    out.append(
+        " ;" "\n");
 
-    if (bankInsert.second) {
-        printf(
-            "\n"
-            "syn:bank%04u" "\n"
-            "\t" "rdfs:label \"\"\"%s\"\"\" ." "\n",
-            bankno, ins.filename);
+    if (gWriteWoplFields) {
+        unsigned fields[kWoplFieldCount];
+        getWoplFields(preset, fields);
+        for (unsigned i = 0; i < kWoplFieldCount; ++i) {
+            out.append("\t" "wopl:");
+            out.append(kWoplFieldNames[i]);
+            out.push_back(' ');
+            appendUnsigned(out, fields[i]);
+            out.append(" ;" "\n");
+        }
     }
 
-    printf(
-        "\n"
-        "syn:preset%04u" "\n"
-        "\t" "rdfs:label \"\"\"%s\"\"\" ;" "\n"
-        "\t" "pset:bank syn:bank%04u ;" "\n",
-        index, name, bankno);
+    // the duplicates which were left out, by bank and name
+    for (const Preset *alias : preset.aliases) {
+        std::string comment;
+        comment.append("Also ");
+        comment.append(alias->name);
+        comment.append(" in ");
+        comment.append(alias->bankName);
+        out.append(
+            "\t" "rdfs:comment ");
+        appendTtlString(out, comment.c_str());
+        out.append(
+            " ;" "\n");
+    }
 
-    printf(
+    out.append(
         "\t" "lv2:port\n");
     for (unsigned i = 0; i < paramCount; ++i) {
-        printf(
+        out.append(
             "\t" "[\n"
-            "\t\t" "lv2:symbol \"\"\"%s\"\"\" ;\n"
-            "\t\t" "pset:value %d.0 ;\n"
-            "\t" "]",
-            gParameters[i].symbol.buffer(), values[i]);
+            "\t\t" "lv2:symbol ");
+        appendTtlString(out, ParameterInfos[i].symbol);
+        out.append(
+            " ;\n"
+            "\t\t" "pset:value ");
+        appendInteger(out, preset.values[i]);
+        out.append(
+            ".0 ;\n"
+            "\t" "]");
 
         if (i < paramCount - 1)
-            printf(",\n");
+            out.append(",\n");
         else
-            printf(" .\n");
+            out.append(" .\n");
     }
 }
 
-void extractAllInstruments(const WOPLFile &file, const char *name, std::vector<Ins> &instlist)
+void writeDuplicateAsLv2PresetTtl(std::string &out, const Preset &preset)
+{
+    // not a preset, only the placement of the instrument and a reference to
+    // the preset which has its values, for preset2bank
+    out.append(
+        "\n"
+        "syn:preset");
+    appendUnsigned(out, preset.index, 4);
+    out.append(
+        "\n"
+        "\t" "rdfs:label ");
+    appendTtlString(out, preset.name.c_str());
+    out.append(
+        " ;" "\n"
+        "\t" "pset:bank syn:bank");
+    appendUnsigned(out, preset.bankno, 4);
+    out.append(
+        " ;" "\n");
+
+    unsigned fields[kWoplFieldCount];
+    getWoplFields(preset, fields);
+    for (unsigned i = 0; i < kWoplFieldCount; ++i) {
+        out.append("\t" "wopl:");
+        out.append(kWoplFieldNames[i]);
+        out.push_back(' ');
+        appendUnsigned(out, fields[i]);
+        out.append(" ;" "\n");
+    }
+
+    out.append(
+        "\t" "wopl:duplicateOf syn:preset");
+    appendUnsigned(out, preset.duplicateOf->index, 4);
+    out.append(
+        " .\n");
+}
+
+void extractAllInstruments(const WOPLFile &file, std::vector<Ins> &instlist)
 {
     instlist.reserve(instlist.size() +
         128 * (file.banks_count_melodic + file.banks_count_percussion));
@@ -263,7 +874,6 @@ void extractAllInstruments(const WOPLFile &file, const char *name, std::vector<I
             if ((inst.inst_flags & WOPL_Ins_IsBlank) == 0) {
                 Ins ins;
                 ins.file = &file;
-                ins.filename = name;
                 ins.bank = &bank;
                 ins.program_number = j;
                 ins.isdrum = false;
@@ -279,7 +889,6 @@ void extractAllInstruments(const WOPLFile &file, const char *name, std::vector<I
             if ((inst.inst_flags & WOPL_Ins_IsBlank) == 0) {
                 Ins ins;
                 ins.file = &file;
-                ins.filename = name;
                 ins.bank = &bank;
                 ins.program_number = j;
                 ins.isdrum = true;
@@ -289,56 +898,511 @@ void extractAllInstruments(const WOPLFile &file, const char *name, std::vector<I
     }
 }
 
-unsigned identifyMidiSpec(const std::vector<Ins> &instlist)
+MidiSpecCount countMidiSpecs(const std::vector<Preset> &presets)
 {
-    unsigned numGS = 0;
-    unsigned numXG = 0;
+    MidiSpecCount count;
 
-    for (size_t index = 0, count = instlist.size(); index < count; ++index) {
-        const Ins &ins = instlist[index];
-        MidiProgramId id(ins.isdrum, ins.bank->bank_midi_msb, ins.bank->bank_midi_lsb, ins.program_number);
+    // the identifiers of the banks, as getMidiBank does
+    std::vector<MidiProgramId> ids;
+    ids.reserve(presets.size());
+    for (const Preset &preset : presets) {
+        MidiProgramId id = preset.id;
+        id.reserved = 1;
+        id.program = 0;
+        ids.push_back(id);
+    }
 
-        unsigned spec = kMidiSpecAny;
-        const MidiProgram *bank = getMidiBank(id, spec, &spec);
+    std::vector<MidiProgram> banks(ids.size());
+    std::vector<unsigned> specs(ids.size());
+    getMidiPrograms(ids.data(), ids.size(), kMidiSpecAny, banks.data(), specs.data());
 
-        if (bank) {
-            switch (spec) {
-            case kMidiSpecSC:
-            case kMidiSpecGS:
-                ++numGS;
-                break;
-            case kMidiSpecXG:
-                ++numXG;
-                break;
-            }
+    for (size_t index = 0, n = ids.size(); index < n; ++index) {
+        switch (specs[index]) {
+        case kMidiSpecSC:
+        case kMidiSpecGS:
+            ++count.numGS;
+            break;
+        case kMidiSpecXG:
+            ++count.numXG;
+            break;
         }
     }
 
+    return count;
+}
+
+unsigned identifyMidiSpec(const MidiSpecCount &count)
+{
     unsigned spec = kMidiSpecGM1|kMidiSpecGM2;
-    if (numGS > numXG)
+    if (count.numGS > count.numXG)
         spec |= kMidiSpecGS|kMidiSpecSC;
-    else if (numXG > numGS)
+    else if (count.numXG > count.numGS)
         spec |= kMidiSpecXG;
 
     return spec;
 }
 
-WOPLFile *WOPL_LoadBankFromFile(const char *filepath)
+void parallelFor(size_t count, unsigned numThreads, const std::function<void(size_t)> &fn)
+{
+    if (numThreads > count)
+        numThreads = count;
+
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i; (i = next++) < count;)
+            fn(i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for (unsigned t = 1; t < numThreads; ++t)
+        threads.emplace_back(work);
+    work();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+size_t PresetValuesHash::operator()(const int *values) const noexcept
 {
-    FILE_u fh{fopen(filepath, "rb")};
-    if (!fh)
-        return nullptr;
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (unsigned i = 0; i < paramCount; ++i) {
+        hash ^= (uint32_t)values[i];
+        hash *= 0x100000001b3u;
+    }
+    return (size_t)hash;
+}
+
+bool PresetValuesEqual::operator()(const int *a, const int *b) const noexcept
+{
+    return !memcmp(a, b, paramCount * sizeof(int));
+}
+
+void appendUnsigned(std::string &out, unsigned value, unsigned width)
+{
+    char buf[16];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
 
-    fseek(fh.get(), 0, SEEK_END);
-    off_t size = ftell(fh.get());
-    if (size < 0 || size > 32 * 1024 * 1024)
-        return nullptr;
+    while ((unsigned)(end - p) < width && p > buf)
+        *--p = '0';
 
-    std::unique_ptr<char[]> data{new char[size]};
-    rewind(fh.get());
+    out.append(p, end);
+}
 
-    if (fread(data.get(), size, 1, fh.get()) != 1)
-        return nullptr;
+void appendInteger(std::string &out, int value)
+{
+    unsigned magnitude = (unsigned)value;
+    if (value < 0) {
+        out.push_back('-');
+        magnitude = 0u - magnitude;
+    }
+    appendUnsigned(out, magnitude);
+}
 
-    return WOPL_LoadBankFromMem(data.get(), size, nullptr);
+void appendTtlString(std::string &out, const char *str)
+{
+    out.append("\"\"\"");
+    for (const char *p = str; *p; ++p) {
+        unsigned char c = *p;
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\t': out.append("\\t"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                static const char hex[] = "0123456789ABCDEF";
+                char esc[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                out.append(esc, sizeof(esc));
+            }
+            else
+                out.push_back(c);
+            break;
+        }
+    }
+    out.append("\"\"\"");
+}
+
+void appendTsvField(std::string &out, const char *str)
+{
+    // escaped, so the names cannot split the lines and the columns
+    for (const char *p = str; *p; ++p) {
+        unsigned char c = *p;
+        switch (c) {
+        case '\\': out.append("\\\\"); break;
+        case '\t': out.append("\\t"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                static const char hex[] = "0123456789ABCDEF";
+                char esc[] = {'\\', 'x', hex[c >> 4], hex[c & 15]};
+                out.append(esc, sizeof(esc));
+            }
+            else
+                out.push_back(c);
+            break;
+        }
+    }
+}
+
+void appendCString(std::string &out, const char *str)
+{
+    out.push_back('"');
+    for (const char *p = str; *p; ++p) {
+        unsigned char c = *p;
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\t': out.append("\\t"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                char esc[] = {'\\', char('0' + (c >> 6)), char('0' + ((c >> 3) & 7)), char('0' + (c & 7))};
+                out.append(esc, sizeof(esc));
+            }
+            else
+                out.push_back(c);
+            break;
+        }
+    }
+    out.push_back('"');
+}
+
+void appendHex(std::string &out, uint64_t value, unsigned width)
+{
+    static const char hex[] = "0123456789abcdef";
+    char buf[16];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+
+    do {
+        *--p = hex[value & 15];
+        value >>= 4;
+    } while (value > 0);
+
+    while ((unsigned)(end - p) < width && p > buf)
+        *--p = '0';
+
+    out.append(p, end);
+}
+
+bool writeFile(const char *filepath, const std::string &data)
+{
+    FD_u fd;
+    fd.reset(open(filepath, O_WRONLY|O_CREAT|O_TRUNC|O_BINARY, 0666));
+    if (!fd)
+        return false;
+    return writeAll(fd.get(), data.data(), data.size());
+}
+
+bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t count = write(fd, data, size);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+// cache file: header, then the instruments
+//   header: "B2PC", version, paramCount, numGS, numXG, count
+//   instrument: MIDI program identifier, values[paramCount],
+//               percussion key and flags, delays on and off, name size, name
+// all the integers are 32-bit little-endian, except the name size which is 8-bit
+
+static const char kCacheMagic[4] = {'B', '2', 'P', 'C'};
+static const uint32_t kCacheVersion = 2;
+
+// the version of the conversion, to increment when it changes the presets
+// of the same bank, so the cache files of the previous versions are not used
+static const uint32_t kConverterVersion = 1;
+
+static void putUint32(std::string &out, uint32_t value)
+{
+    char bytes[4] = {char(value & 255), char((value >> 8) & 255), char((value >> 16) & 255), char(value >> 24)};
+    out.append(bytes, 4);
+}
+
+static bool getUint32(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    if (end - p < 4)
+        return false;
+    value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    p += 4;
+    return true;
+}
+
+bool loadCachedBank(const char *filepath, BankJob &job)
+{
+    FileData data;
+    if (!data.load(filepath))
+        return false;
+
+    const uint8_t *p = data.data();
+    const uint8_t *end = p + data.size();
+
+    uint32_t version, count, numParameters, numGS, numXG;
+    if (end - p < 4 || memcmp(p, kCacheMagic, 4))
+        return false;
+    p += 4;
+    if (!getUint32(p, end, version) || version != kCacheVersion)
+        return false;
+    if (!getUint32(p, end, numParameters) || numParameters != paramCount)
+        return false;
+    if (!getUint32(p, end, numGS) || !getUint32(p, end, numXG) || !getUint32(p, end, count))
+        return false;
+
+    // the count is checked against the size before it is allocated
+    const size_t minimumRecordSize = 4 * (paramCount + 3) + 1;
+    if (count > (size_t)(end - p) / minimumRecordSize)
+        return false;
+
+    std::vector<Preset> presets{count};
+    for (Preset &preset : presets) {
+        uint32_t value;
+        if (!getUint32(p, end, value))
+            return false;
+        preset.id = MidiProgramId{value};
+        for (unsigned i = 0; i < paramCount; ++i) {
+            if (!getUint32(p, end, value))
+                return false;
+            preset.values[i] = (int32_t)value;
+        }
+        if (!getUint32(p, end, value))
+            return false;
+        preset.percussionKey = value & 255;
+        preset.flags = (value >> 8) & 255;
+        if (!getUint32(p, end, value))
+            return false;
+        preset.delayOnMs = value & 65535;
+        preset.delayOffMs = value >> 16;
+        if (end - p < 1)
+            return false;
+        size_t namelen = *p++;
+        if ((size_t)(end - p) < namelen)
+            return false;
+        preset.name.assign((const char *)p, namelen);
+        preset.named = namelen > 0;
+        p += namelen;
+    }
+
+    if (p != end)
+        return false;
+
+    job.presets = std::move(presets);
+    job.specCount.numGS = numGS;
+    job.specCount.numXG = numXG;
+    return true;
+}
+
+bool storeCachedBank(const char *filepath, const BankJob &job)
+{
+    std::string out;
+    out.append(kCacheMagic, 4);
+    putUint32(out, kCacheVersion);
+    putUint32(out, paramCount);
+    putUint32(out, job.specCount.numGS);
+    putUint32(out, job.specCount.numXG);
+    putUint32(out, job.presets.size());
+
+    for (const Preset &preset : job.presets) {
+        putUint32(out, preset.id.identifier);
+        for (unsigned i = 0; i < paramCount; ++i)
+            putUint32(out, (uint32_t)preset.values[i]);
+        putUint32(out, preset.percussionKey | (preset.flags << 8));
+        putUint32(out, preset.delayOnMs | ((uint32_t)preset.delayOffMs << 16));
+        size_t namelen = std::min<size_t>(preset.name.size(), 255);
+        out.push_back((char)namelen);
+        out.append(preset.name.data(), namelen);
+    }
+
+    // write a temporary file, and move it in place; its name is unique
+    // among the threads and the processes which share the directory
+    std::string temppath = filepath;
+    temppath.append(".tmp");
+#if defined(_WIN32)
+    appendUnsigned(temppath, (unsigned)_getpid());
+#else
+    appendUnsigned(temppath, (unsigned)getpid());
+#endif
+    temppath.push_back('-');
+    appendUnsigned(temppath, gCacheTempCounter++);
+
+    if (!writeFile(temppath.c_str(), out)) {
+        remove(temppath.c_str());
+        return false;
+    }
+
+    if (rename(temppath.c_str(), filepath) != 0) {
+        remove(filepath);
+        if (rename(temppath.c_str(), filepath) != 0) {
+            remove(temppath.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the inputs of the conversion other than the bank: the converter,
+// the parameters, and the MIDI name database
+uint64_t hashConversion()
+{
+    uint64_t hash = hashBytes(nullptr, 0);
+
+    auto hashUint32 = [&hash](uint32_t value) {
+        std::string bytes;
+        putUint32(bytes, value);
+        hash = hashBytes((const uint8_t *)bytes.data(), bytes.size(), hash);
+    };
+    auto hashFloat = [&hashUint32](float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        hashUint32(bits);
+    };
+    auto hashString = [&hash](const char *str) {
+        hash = hashBytes((const uint8_t *)str, strlen(str) + 1, hash);
+    };
+
+    hashUint32(kConverterVersion);
+
+    hashUint32(paramCount);
+    for (unsigned p = 0; p < paramCount; ++p) {
+        const ParameterInfo &info = ParameterInfos[p];
+        hashString(info.name);
+        hashString(info.symbol);
+        hashFloat(info.def);
+        hashFloat(info.min);
+        hashFloat(info.max);
+        hashUint32(info.hints);
+        hashUint32(info.labelCount);
+        for (unsigned i = 0; i < info.labelCount; ++i)
+            hashString(info.labels[i]);
+    }
+
+    uint64_t names = getMidiNamesHash();
+    hashUint32((uint32_t)names);
+    hashUint32((uint32_t)(names >> 32));
+
+    return hash;
+}
+
+uint64_t hashBytes(const uint8_t *data, size_t size, uint64_t hash)
+{
+    // FNV-1a, which continues the given hash
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+bool makeDirectories(const char *path)
+{
+    std::string dir = path;
+    for (size_t pos = 1; pos <= dir.size(); ++pos) {
+        if (pos < dir.size() && dir[pos] != '/')
+            continue;
+        std::string prefix = dir.substr(0, pos);
+#if defined(_WIN32)
+        _mkdir(prefix.c_str());
+#else
+        mkdir(prefix.c_str(), 0777);
+#endif
+    }
+
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FileData::load(const char *filepath)
+{
+    bool isStdin = !strcmp(filepath, "-");
+
+    FD_u fd;
+    if (isStdin) {
+#if defined(_WIN32)
+        _setmode(STDIN_FILENO, _O_BINARY);
+#endif
+    }
+    else {
+        fd.reset(open(filepath, O_RDONLY|O_BINARY));
+        if (!fd)
+            return false;
+    }
+
+    int fdin = isStdin ? STDIN_FILENO : fd.get();
+
+#if defined(BANK2PRESET_HAVE_MMAP)
+    // map the regular files, which are then decoded in place
+    struct stat st;
+    if (fstat(fdin, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t size = (size_t)st.st_size;
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fdin, 0);
+        if (addr != MAP_FAILED) {
+            map_ = addr;
+            data_ = (const uint8_t *)addr;
+            size_ = size;
+            return true;
+        }
+    }
+#endif
+
+    // otherwise, read the stream until the end
+    size_t size = 0;
+    for (;;) {
+        if (buffer_.size() - size < 65536)
+            buffer_.resize(buffer_.size() + std::max<size_t>(65536, buffer_.size()));
+        ssize_t count = read(fdin, &buffer_[size], buffer_.size() - size);
+        if (count == 0)
+            break;
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        size += (size_t)count;
+    }
+
+    data_ = buffer_.data();
+    size_ = size;
+    return true;
+}
+
+FileData::~FileData()
+{
+#if defined(BANK2PRESET_HAVE_MMAP)
+    if (map_)
+        munmap(map_, size_);
+#endif
+}
+
+void FD_u::reset(int fd) noexcept
+{
+    if (fd_ != -1)
+        close(fd_);
+    fd_ = fd;
 }
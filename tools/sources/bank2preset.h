@@ -1,9 +1,12 @@
 #pragma once
 #include "../thirdparty/libADLMIDI/src/wopl/wopl_file.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include "audition.h"
 #include <ins_names.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include <memory>
 #include <cstdio>
 #include <cstring>
@@ -13,6 +16,37 @@
 struct FILE_deleter { void operator()(FILE *x) const noexcept { fclose(x); } };
 typedef std::unique_ptr<FILE, FILE_deleter> FILE_u;
 
+//
+struct FD_u {
+    FD_u() noexcept {}
+    ~FD_u() noexcept { reset(); }
+    FD_u(const FD_u &) = delete;
+    FD_u &operator=(const FD_u &) = delete;
+    int get() const noexcept { return fd_; }
+    void reset(int fd = -1) noexcept;
+    explicit operator bool() const noexcept { return fd_ != -1; }
+private:
+    int fd_ = -1;
+};
+
+//
+// the contents of a file, mapped in memory when possible
+struct FileData {
+    FileData() noexcept {}
+    ~FileData() noexcept;
+    FileData(const FileData &) = delete;
+    FileData &operator=(const FileData &) = delete;
+    // load from a file path, or from the standard input if it is "-"
+    bool load(const char *filepath);
+    const uint8_t *data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+private:
+    void *map_ = nullptr;
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint8_t> buffer_;
+};
+
 //
 struct WOPL_deleter { void operator()(WOPLFile *x) const noexcept { WOPL_Free(x); } };
 typedef std::unique_ptr<WOPLFile, WOPL_deleter> WOPLFile_u;
@@ -20,25 +54,139 @@ typedef std::unique_ptr<WOPLFile, WOPL_deleter> WOPLFile_u;
 //
 struct Ins {
     const WOPLFile *file;
-    const char *filename;
     const WOPLBank *bank;
     uint8_t program_number;
     bool isdrum;
 };
 
 //
-void convertInstrumentList(const std::vector<Ins> &instlist);
-void convertInstrument(unsigned index, const Ins &ins, unsigned spec);
+struct Preset {
+    unsigned index = 0;
+    unsigned bankno = 0;
+    const char *bankName = nullptr;
+    MidiProgramId id;
+    std::string name;
+    int values[paramCount] = {};
+    // the fields of the WOPL instrument which are not parameters, written
+    // with -w so that preset2bank restores them; the placement is in `id`
+    bool named = false;
+    uint8_t percussionKey = 0;
+    uint8_t flags = 0;
+    uint16_t delayOnMs = 0;
+    uint16_t delayOffMs = 0;
+    // when deduplicating, the preset with identical values which came first
+    const Preset *duplicateOf = nullptr;
+    std::vector<const Preset *> aliases;
+    // when auditioning, the analysis of the sound
+    AuditionResult audition;
+    // silent and left out of the output with -X, but numbered and reported
+    bool omitted = false;
+};
+
+struct PresetValuesHash {
+    size_t operator()(const int *values) const noexcept;
+};
+
+struct PresetValuesEqual {
+    bool operator()(const int *a, const int *b) const noexcept;
+};
+
+//
+struct MidiSpecCount {
+    unsigned numGS = 0;
+    unsigned numXG = 0;
+};
+
+//
+struct BankJob {
+    std::string filepath;
+    std::string name;
+    unsigned bankno = 0;
+    bool writesBank = false;
+    size_t firstIndex = 0;
+    MidiSpecCount specCount;
+    std::vector<Preset> presets;
+    std::string output;
+    // in bundle mode, the pieces of the presets documents by file name
+    std::vector<std::pair<std::string, std::string>> documents;
+};
+
+//
+enum Lv2Split {
+    kSplitNone,
+    kSplitPerBank,
+    kSplitPerCount,
+};
+
+bool writeBundle(const char *dir, std::vector<BankJob> &jobs, size_t numInstruments, unsigned numThreads);
+std::string lv2DocumentName(unsigned bankno, unsigned index);
+std::string &documentOutput(BankJob &job, const std::string &docname);
+
+//
+enum {
+    // the largest fingerprint distance between similar presets
+    kSimilarDistance = 2,
+};
+
+void auditionAllPresets(std::vector<BankJob> &jobs, unsigned numThreads);
+bool writeAuditionReport(const char *filepath, const std::vector<BankJob> &jobs);
+
+//
+bool runStreaming(const char *listpath);
+bool readLine(FILE *fh, std::string &line);
+
+//
+std::string bankNameOfPath(const std::string &path);
+void numberBank(BankJob &job, std::unordered_map<std::string, unsigned> &banksKnown, size_t &numInstruments);
+void writeBank(std::string &out, const BankJob &job);
+
+//
+bool loadBank(BankJob &job);
+void convertInstrumentList(const std::vector<Ins> &instlist, std::vector<Preset> &presets);
+void convertInstrument(const Ins &ins, Preset &preset);
+void nameInstruments(std::vector<Preset> &presets, unsigned spec);
+
+//
+bool loadCachedBank(const char *filepath, BankJob &job);
+bool storeCachedBank(const char *filepath, const BankJob &job);
+uint64_t hashConversion();
+uint64_t hashBytes(const uint8_t *data, size_t size, uint64_t hash = 0xcbf29ce484222325u);
+
+//
+// the fields of the WOPL instruments written with -w, by name
+enum { kWoplFieldCount = 9 };
+extern const char *const kWoplFieldNames[kWoplFieldCount];
+void getWoplFields(const Preset &preset, unsigned fields[kWoplFieldCount]);
+
+//
+typedef void (*writeHeaderFn)(std::string &out);
+void writeHeaderAsLv2Ttl(std::string &out);
+
+typedef void (*writeBankFn)(std::string &out, const BankJob &job);
+void writeBankAsLv2ManTtl(std::string &out, const BankJob &job);
+void writeBankAsLv2PresetTtl(std::string &out, const BankJob &job);
+
+typedef void (*writeInstrumentFn)(std::string &out, const Preset &preset);
+void writeInstrumentAsCpp(std::string &out, const Preset &preset);
+void writeInstrumentAsLv2ManTtl(std::string &out, const Preset &preset);
+void writeInstrumentAsLv2PresetTtl(std::string &out, const Preset &preset);
+void writeDuplicateAsLv2PresetTtl(std::string &out, const Preset &preset);
 
 //
-typedef void (*writeInstrumentFn)(unsigned index, const Ins &ins, const char *name, const int values[]);
-void writeInstrumentAsCpp(unsigned index, const Ins &ins, const char *name, const int values[]);
-void writeInstrumentAsLv2ManTtl(unsigned index, const Ins &ins, const char *name, const int values[]);
-void writeInstrumentAsLv2PresetTtl(unsigned index, const Ins &ins, const char *name, const int values[]);
+void extractAllInstruments(const WOPLFile &file, std::vector<Ins> &instlist);
+MidiSpecCount countMidiSpecs(const std::vector<Preset> &presets);
+unsigned identifyMidiSpec(const MidiSpecCount &count);
 
 //
-void extractAllInstruments(const WOPLFile &file, const char *name, std::vector<Ins> &instlist);
-unsigned identifyMidiSpec(const std::vector<Ins> &instlist);
+void parallelFor(size_t count, unsigned numThreads, const std::function<void(size_t)> &fn);
 
 //
-WOPLFile *WOPL_LoadBankFromFile(const char *filepath);
+void appendUnsigned(std::string &out, unsigned value, unsigned width = 0);
+void appendInteger(std::string &out, int value);
+void appendHex(std::string &out, uint64_t value, unsigned width = 0);
+void appendTtlString(std::string &out, const char *str);
+void appendCString(std::string &out, const char *str);
+void appendTsvField(std::string &out, const char *str);
+bool writeFile(const char *filepath, const std::string &data);
+bool writeAll(int fd, const char *data, size_t size);
+bool makeDirectories(const char *path);
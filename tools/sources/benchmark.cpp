@@ -0,0 +1,167 @@
+#include "alloc_count.h"
+#include "../../sources/plugin/CoreMiniOPL3.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <getopt.h>
+
+//------------------------------------------------------------------------------
+static const unsigned kSampleRate = 44100;
+static const unsigned kBlockSize = 512;
+
+struct Benchmark {
+    const char *name;
+    const char *description;
+    // run the operation once, the argument is the iteration number
+    std::function<void(unsigned)> fn;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: miniopl3-benchmark [options] [benchmark...]\n"
+        "  -n <count>     number of iterations (default: 10000)\n"
+        "  -l             list the benchmarks\n");
+}
+
+static void runBenchmark(const Benchmark &bench, unsigned iterations)
+{
+    using clock = std::chrono::steady_clock;
+
+    // warm up, so that the first allocations of lazy state are not counted
+    for (unsigned i = 0; i < iterations / 10 + 1; ++i)
+        bench.fn(i);
+
+    uint64_t allocCount = allocationCount();
+    uint64_t allocBytes = allocationBytes();
+    clock::time_point start = clock::now();
+
+    for (unsigned i = 0; i < iterations; ++i)
+        bench.fn(i);
+
+    clock::time_point end = clock::now();
+    allocCount = allocationCount() - allocCount;
+    allocBytes = allocationBytes() - allocBytes;
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-16s %12.1f %12.2f %12.1f\n", bench.name, ns / iterations,
+           (double)allocCount / iterations, (double)allocBytes / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned iterations = 10000;
+    bool list = false;
+
+    for (int c; (c = getopt(argc, argv, "n:l")) != -1;) {
+        switch (c) {
+        case 'n':
+            iterations = std::atoi(optarg);
+            break;
+        case 'l':
+            list = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (iterations == 0) {
+        fprintf(stderr, "Invalid number of iterations.\n");
+        return 1;
+    }
+
+    //
+    CoreMiniOPL3 core;
+    core.setSampleRate(kSampleRate);
+    core.setEmulator(ADLMIDI_EMU_DOSBOX);
+    core.activate();
+
+    std::unique_ptr<float[]> buffer{new float[2 * kBlockSize]};
+    float *outputs[] = {&buffer[0], &buffer[kBlockSize]};
+
+    ADL_Instrument instrument = {};
+
+    struct ADL_delete {
+        void operator()(ADL_MIDIPlayer *x) const noexcept { adl_close(x); }
+    };
+    std::unique_ptr<ADL_MIDIPlayer, ADL_delete> player{adl_init(kSampleRate)};
+    if (!player) {
+        fprintf(stderr, "Cannot create the player.\n");
+        return 1;
+    }
+
+    // one note held, so the blocks have a voice to generate
+    MidiEvent noteOn = {};
+    noteOn.size = 3;
+    noteOn.data[0] = 0x90;
+    noteOn.data[1] = 60;
+    noteOn.data[2] = 100;
+    core.run(outputs, kBlockSize, &noteOn, 1);
+
+    const Benchmark benchmarks[] = {
+        {"pack", "set all the instrument parameters into an ADL_Instrument",
+         [&](unsigned i) {
+             const Program &pgm = EmbeddedPrograms[i % programCount];
+             for (unsigned p = paramAlgorithm; p < paramCount; ++p)
+                 SetInstrumentParameter(instrument, p, pgm.values[p]);
+         }},
+        {"bank-set", "adl_getBank with ADLMIDI_Bank_Create, and adl_setInstrument",
+         [&](unsigned) {
+             ADL_BankId bankId = {0, 0, 0};
+             ADL_Bank bank = {};
+             adl_getBank(player.get(), &bankId, ADLMIDI_Bank_Create, &bank);
+             adl_setInstrument(player.get(), &bank, 0, &instrument);
+         }},
+        {"param", "change an operator parameter, updating the program",
+         [&](unsigned i) {
+             core.setParameterValue(paramOp1Level, i & 63);
+         }},
+        {"algorithm", "switch the algorithm between 2-op and 4-op, updating the program and the 4-op channels",
+         [&](unsigned i) {
+             core.setParameterValue(paramAlgorithm, (i & 1) ? 2 : 0);
+         }},
+        {"num-chips", "change the number of chips, updating the 4-op channels",
+         [&](unsigned i) {
+             core.setParameterValue(paramNumChips, 1 + (i & 1));
+         }},
+        {"program", "load an embedded program, as loadProgram does",
+         [&](unsigned i) {
+             core.setParameterValues(EmbeddedPrograms[i % programCount].values);
+         }},
+        {"block", "process a block",
+         [&](unsigned) {
+             core.run(outputs, kBlockSize, nullptr, 0);
+         }},
+        {"storm", "process a block after setting every parameter, as an automating host does",
+         [&](unsigned i) {
+             const Program &pgm = EmbeddedPrograms[i % programCount];
+             for (unsigned p = 0; p < paramCount; ++p)
+                 core.setParameterValue(p, pgm.values[p]);
+             core.run(outputs, kBlockSize, nullptr, 0);
+         }},
+    };
+
+    if (list) {
+        for (const Benchmark &bench : benchmarks)
+            printf("%-16s %s\n", bench.name, bench.description);
+        return 0;
+    }
+
+    printf("%-16s %12s %12s %12s\n", "benchmark", "ns/call", "allocs/call", "bytes/call");
+
+    for (const Benchmark &bench : benchmarks) {
+        bool selected = optind == argc;
+        for (int i = optind; i < argc && !selected; ++i)
+            selected = !strcmp(argv[i], bench.name);
+        if (selected)
+            runBenchmark(bench, iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+// Generate the tables of the MIDI name database, as a header which is
+// included by ins_names.cpp.
+//  - the names are stored once in a string pool, and designated by 16-bit
+//    offsets, or by 16-bit numbers in a table of offsets if the pool is large
+//  - the programs of all sets are stored in columns, one array per field
+//  - the lookups are binary searches in one index sorted by identifier, which
+//    has the entries of the same identifier in the order of precedence
+
+#include <ins_names.h>
+#include <ins_names_data.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdint>
+
+struct ProgramSet {
+    MidiSpec spec;
+    const MidiProgram *programs;
+    unsigned count;
+};
+
+struct NamePool {
+    std::string data;
+    // the offset in the pool of every distinct name
+    std::map<std::string, uint32_t> offsets;
+};
+
+static void buildNamePool(const std::vector<const MidiProgram *> &rows, NamePool &pool);
+static void writeNamePool(FILE *out, const NamePool &pool, bool withOffsetTable,
+                          std::map<std::string, unsigned> &numbers);
+static bool writeIndex(FILE *out, const ProgramSet *sets, unsigned numSets);
+static uint64_t hashSets(const ProgramSet *sets, unsigned numSets);
+
+template <class T, class Fn>
+static void writeColumn(FILE *out, const char *type, const char *name,
+                        const std::vector<T> &rows, Fn fn);
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: gen-ins-names <output.h>\n");
+        return 1;
+    }
+
+    // in order of precedence
+    const ProgramSet sets[] = {
+        {kMidiSpecXG, XgSet, sizeof(XgSet) / sizeof(*XgSet)},
+        {kMidiSpecGS, GsSet, sizeof(GsSet) / sizeof(*GsSet)},
+        {kMidiSpecSC, ScSet, sizeof(ScSet) / sizeof(*ScSet)},
+        {kMidiSpecGM2, Gm2Set, sizeof(Gm2Set) / sizeof(*Gm2Set)},
+        {kMidiSpecGM1, Gm1Set, sizeof(Gm1Set) / sizeof(*Gm1Set)},
+    };
+
+    std::vector<const MidiProgram *> rows;
+    for (const ProgramSet &set : sets) {
+        for (unsigned i = 0; i < set.count; ++i)
+            rows.push_back(&set.programs[i]);
+    }
+
+    if (rows.size() > UINT16_MAX) {
+        fprintf(stderr, "There are too many programs.\n");
+        return 1;
+    }
+
+    NamePool pool;
+    buildNamePool(rows, pool);
+
+    // beyond 64 KiB, the names are numbered, and the numbers are 16-bit
+    bool withOffsetTable = pool.data.size() > UINT16_MAX;
+    if (withOffsetTable && pool.offsets.size() > UINT16_MAX) {
+        fprintf(stderr, "There are too many names.\n");
+        return 1;
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Cannot open the output file.\n");
+        return 1;
+    }
+
+    fprintf(out, "// generated by gen-ins-names, do not edit\n");
+
+    // identifies the content, for the caches of the data derived from it
+    fprintf(out, "\n#define INS_NAMES_HASH UINT64_C(0x%016llx)\n",
+            (unsigned long long)hashSets(sets, sizeof(sets) / sizeof(*sets)));
+
+    std::map<std::string, unsigned> numbers;
+    writeNamePool(out, pool, withOffsetTable, numbers);
+
+    auto nameRef = [&](const char *name) -> unsigned {
+        return withOffsetTable ? numbers[name] : pool.offsets[name];
+    };
+
+    writeColumn(out, "char", "ProgramKind", rows,
+                [](const MidiProgram *pgm) -> unsigned { return pgm->kind; });
+    writeColumn(out, "unsigned char", "ProgramBankMsb", rows,
+                [](const MidiProgram *pgm) -> unsigned { return pgm->bankMsb; });
+    writeColumn(out, "unsigned char", "ProgramBankLsb", rows,
+                [](const MidiProgram *pgm) -> unsigned { return pgm->bankLsb; });
+    writeColumn(out, "unsigned char", "ProgramNumber", rows,
+                [](const MidiProgram *pgm) -> unsigned { return pgm->program; });
+    writeColumn(out, "uint16_t", "ProgramBankName", rows,
+                [&](const MidiProgram *pgm) -> unsigned { return nameRef(pgm->bankName); });
+    writeColumn(out, "uint16_t", "ProgramPatchName", rows,
+                [&](const MidiProgram *pgm) -> unsigned { return nameRef(pgm->patchName); });
+
+    if (!writeIndex(out, sets, sizeof(sets) / sizeof(*sets))) {
+        fprintf(stderr, "There are too many entries in the index.\n");
+        fclose(out);
+        return 1;
+    }
+
+    if (fflush(out) != 0 || ferror(out)) {
+        fprintf(stderr, "Cannot write the output file.\n");
+        fclose(out);
+        return 1;
+    }
+
+    fclose(out);
+    return 0;
+}
+
+static void buildNamePool(const std::vector<const MidiProgram *> &rows, NamePool &pool)
+{
+    std::vector<std::string> names;
+    for (const MidiProgram *pgm : rows) {
+        names.push_back(pgm->bankName);
+        names.push_back(pgm->patchName);
+    }
+
+    // sort by reversed names, so a name which ends another comes just before it
+    for (std::string &name : names)
+        std::reverse(name.begin(), name.end());
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    // store the longest names first, and the shorter ones as their tails
+    for (size_t i = names.size(); i-- > 0;) {
+        std::string name{names[i].rbegin(), names[i].rend()};
+        if (i + 1 < names.size() && names[i + 1].compare(0, names[i].size(), names[i]) == 0) {
+            std::string next{names[i + 1].rbegin(), names[i + 1].rend()};
+            pool.offsets[name] = pool.offsets[next] + (next.size() - name.size());
+            continue;
+        }
+        pool.offsets[name] = pool.data.size();
+        pool.data.append(name);
+        pool.data.push_back('\0');
+    }
+}
+
+static void writeNamePool(FILE *out, const NamePool &pool, bool withOffsetTable,
+                          std::map<std::string, unsigned> &numbers)
+{
+    fprintf(out, "\n#define INS_NAMES_HAVE_OFFSET_TABLE %d\n", withOffsetTable);
+
+    fprintf(out, "\nstatic const char NamePool[] =\n    \"");
+    for (size_t i = 0, n = pool.data.size(); i < n; ++i) {
+        unsigned char c = pool.data[i];
+        if (c == '\0') {
+            // the final null is the one of the literal
+            if (i + 1 < n)
+                fprintf(out, "\\0\"\n    \"");
+        }
+        else if (c == '"' || c == '\\' || c == '?')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7f)
+            fprintf(out, "\\%03o", c);
+        else
+            fputc(c, out);
+    }
+    fprintf(out, "\";\n");
+
+    if (withOffsetTable) {
+        std::vector<uint32_t> offsets;
+        for (const std::pair<const std::string, uint32_t> &entry : pool.offsets) {
+            numbers[entry.first] = offsets.size();
+            offsets.push_back(entry.second);
+        }
+        writeColumn(out, "uint32_t", "NameOffsets", offsets,
+                    [](uint32_t offset) -> unsigned { return offset; });
+    }
+}
+
+static bool writeIndex(FILE *out, const ProgramSet *sets, unsigned numSets)
+{
+    struct Entry {
+        unsigned spec;
+        unsigned row;
+    };
+
+    // the entries of an identifier are in the order of the sets
+    std::map<uint32_t, std::vector<Entry>> index;
+
+    unsigned firstRow = 0;
+    for (unsigned s = 0; s < numSets; ++s) {
+        const ProgramSet &set = sets[s];
+        std::map<uint32_t, unsigned> setIndex;
+
+        for (unsigned i = 0; i < set.count; ++i) {
+            const MidiProgram &pgm = set.programs[i];
+            MidiProgramId id;
+            id.percussive = pgm.kind == 'P';
+            id.bankMsb = pgm.bankMsb;
+            id.bankLsb = pgm.bankLsb;
+            id.program = pgm.program;
+            // the last program of an identifier has precedence
+            setIndex[id.identifier] = firstRow + i;
+            // the pseudo-entry of the bank is its first program
+            id.reserved = 1;
+            id.program = 0;
+            setIndex.insert(std::make_pair(id.identifier, firstRow + i));
+        }
+
+        for (const std::pair<const uint32_t, unsigned> &entry : setIndex)
+            index[entry.first].push_back(Entry{(unsigned)set.spec, entry.second});
+
+        firstRow += set.count;
+    }
+
+    std::vector<uint32_t> identifiers;
+    std::vector<Entry> entries;
+    for (const std::pair<const uint32_t, std::vector<Entry>> &item : index) {
+        identifiers.insert(identifiers.end(), item.second.size(), item.first);
+        entries.insert(entries.end(), item.second.begin(), item.second.end());
+    }
+
+    if (entries.size() > UINT16_MAX)
+        return false;
+
+    writeColumn(out, "uint32_t", "IndexIdentifiers", identifiers,
+                [](uint32_t identifier) -> unsigned { return identifier; });
+    writeColumn(out, "unsigned char", "IndexSpecs", entries,
+                [](const Entry &entry) -> unsigned { return entry.spec; });
+    writeColumn(out, "uint16_t", "IndexRows", entries,
+                [](const Entry &entry) -> unsigned { return entry.row; });
+    return true;
+}
+
+template <class T, class Fn>
+static void writeColumn(FILE *out, const char *type, const char *name,
+                        const std::vector<T> &rows, Fn fn)
+{
+    fprintf(out, "\nstatic const %s %s[] =\n{", type, name);
+    for (size_t i = 0, n = rows.size(); i < n; ++i)
+        fprintf(out, "%s%u,", (i % 16) ? " " : "\n    ", fn(rows[i]));
+    fprintf(out, "\n};\n");
+}
+
+static uint64_t hashSets(const ProgramSet *sets, unsigned numSets)
+{
+    // FNV-1a of the programs, in the order of precedence
+    uint64_t hash = 0xcbf29ce484222325u;
+    auto hashByte = [&hash](unsigned byte) {
+        hash ^= byte & 255;
+        hash *= 0x100000001b3u;
+    };
+    auto hashString = [&hashByte](const char *str) {
+        do
+            hashByte(*str);
+        while (*str++);
+    };
+
+    for (unsigned s = 0; s < numSets; ++s) {
+        const ProgramSet &set = sets[s];
+        hashByte(set.spec);
+        for (unsigned i = 0; i < set.count; ++i) {
+            const MidiProgram &pgm = set.programs[i];
+            hashByte(pgm.kind);
+            hashByte(pgm.bankMsb);
+            hashByte(pgm.bankLsb);
+            hashByte(pgm.program);
+            hashString(pgm.bankName);
+            hashString(pgm.patchName);
+        }
+        // the end of the set
+        hashByte(0xff);
+    }
+
+    return hash;
+}
@@ -0,0 +1,184 @@
+#include "alloc_count.h"
+#include "random_block.h"
+#include "../../sources/plugin/CoreMiniOPL3.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <getopt.h>
+
+//------------------------------------------------------------------------------
+static const unsigned kSampleRate = 44100;
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: miniopl3-loadtest [options]\n"
+        "  -n <count>     number of instances (default: 16)\n"
+        "  -t <count>     number of threads (default: number of processors)\n"
+        "  -b <frames>    block size (default: 256)\n"
+        "  -d <seconds>   duration of the rendered audio (default: 10)\n"
+        "  -s <seed>      seed of the random events (default: 1)\n");
+}
+
+struct Instance {
+    CoreMiniOPL3 core;
+    std::mt19937 rng;
+};
+
+// the instances of a thread are processed in turn, as a host does in its
+// audio callback, and the cycle misses its deadline if it lasts longer
+// than the duration of the block
+struct Worker {
+    std::vector<Instance *> instances;
+    std::thread thread;
+
+    double busySeconds = 0;
+    double worstSeconds = 0;
+    unsigned long cycles = 0;
+    unsigned long misses = 0;
+};
+
+static void runWorker(Worker &worker, unsigned blockSize, unsigned long cycles,
+                      std::atomic<bool> &start)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::unique_ptr<float[]> buffer{new float[2 * blockSize]};
+    float *outputs[] = {&buffer[0], &buffer[blockSize]};
+
+    // generated in advance of the cycle, it is the host's work
+    std::vector<RandomBlock> blocks(worker.instances.size());
+
+    const double deadline = (double)blockSize / kSampleRate;
+
+    while (!start.load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    for (unsigned long c = 0; c < cycles; ++c) {
+        for (size_t i = 0; i < blocks.size(); ++i)
+            randomBlock(worker.instances[i]->rng, blockSize, blocks[i]);
+
+        clock::time_point begin = clock::now();
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            CoreMiniOPL3 &core = worker.instances[i]->core;
+            const RandomBlock &block = blocks[i];
+            if (block.param != -1)
+                core.setParameterValue(block.param, block.value);
+            core.run(outputs, blockSize, block.events, block.eventCount);
+        }
+
+        double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+        worker.busySeconds += seconds;
+        worker.worstSeconds = std::max(worker.worstSeconds, seconds);
+        worker.misses += seconds > deadline;
+        ++worker.cycles;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned numInstances = 16;
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned blockSize = 256;
+    double duration = 10;
+    unsigned seed = 1;
+
+    for (int c; (c = getopt(argc, argv, "n:t:b:d:s:")) != -1;) {
+        switch (c) {
+        case 'n':
+            numInstances = std::atoi(optarg);
+            break;
+        case 't':
+            numThreads = std::atoi(optarg);
+            break;
+        case 'b':
+            blockSize = std::atoi(optarg);
+            break;
+        case 'd':
+            duration = std::atof(optarg);
+            break;
+        case 's':
+            seed = std::atoi(optarg);
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc) {
+        usage();
+        return 1;
+    }
+
+    if (numInstances == 0 || numThreads == 0 || blockSize == 0 || blockSize > 8192 || !(duration > 0)) {
+        fprintf(stderr, "Invalid number of instances or threads, duration or block size.\n");
+        return 1;
+    }
+
+    numThreads = std::min(numThreads, numInstances);
+
+    // the memory is the one allocated to create and activate an instance
+    std::vector<std::unique_ptr<Instance>> instances(numInstances);
+    uint64_t allocBytes = allocationBytes();
+    for (unsigned i = 0; i < numInstances; ++i) {
+        Instance *instance = new Instance;
+        instances[i].reset(instance);
+        instance->core.setSampleRate(kSampleRate);
+        instance->core.setEmulator(ADLMIDI_EMU_DOSBOX);
+        instance->core.setParameterValues(EmbeddedPrograms[i % programCount].values);
+        instance->core.activate();
+        instance->rng.seed(seed + i);
+    }
+    allocBytes = allocationBytes() - allocBytes;
+
+    std::vector<Worker> workers(numThreads);
+    for (unsigned i = 0; i < numInstances; ++i)
+        workers[i % numThreads].instances.push_back(instances[i].get());
+
+    const unsigned long cycles = (unsigned long)(duration * kSampleRate / blockSize) + 1;
+    const double audioSeconds = (double)cycles * blockSize / kSampleRate;
+
+    std::atomic<bool> start{false};
+    for (Worker &worker : workers)
+        worker.thread = std::thread([&]() { runWorker(worker, blockSize, cycles, start); });
+    start.store(true, std::memory_order_release);
+    for (Worker &worker : workers)
+        worker.thread.join();
+
+    //
+    printf("%u instances, %u threads, blocks of %u frames (%.2f ms), %.1f s of audio\n",
+           numInstances, numThreads, blockSize, 1e3 * blockSize / kSampleRate, audioSeconds);
+    printf("%-8s %10s %10s %10s %12s\n", "thread", "instances", "rtf", "misses", "worst (ms)");
+
+    double busySeconds = 0;
+    unsigned long totalCycles = 0;
+    unsigned long totalMisses = 0;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        const Worker &worker = workers[t];
+        printf("%-8u %10zu %10.3f %10lu %12.3f\n", t, worker.instances.size(),
+               worker.busySeconds / audioSeconds, worker.misses, 1e3 * worker.worstSeconds);
+        busySeconds += worker.busySeconds;
+        totalCycles += worker.cycles;
+        totalMisses += worker.misses;
+    }
+
+    // the real-time factor is the processing time over the audio time,
+    // and a core sustains the instances while it is below 1
+    double rtf = busySeconds / audioSeconds;
+    printf("aggregate rtf %.3f, %.3f per instance, about %.0f instances per core\n",
+           rtf, rtf / numInstances, (rtf > 0) ? (numInstances / rtf) : 0.0);
+    printf("deadline misses %lu of %lu cycles (%.2f%%)\n",
+           totalMisses, totalCycles, 100.0 * totalMisses / totalCycles);
+    printf("memory %llu bytes allocated per instance\n",
+           (unsigned long long)(allocBytes / numInstances));
+
+    return 0;
+}
@@ -0,0 +1,938 @@
+#include "preset2bank.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <getopt.h>
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: preset2bank [options] <preset-file>...\n"
+        "  -o <file>      output file, - for standard output (default: -)\n"
+        "\n"
+        "The preset files are in the formats written by bank2preset,\n"
+        "either the default one or the LV2 presets document.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = "-";
+
+    for (int c; (c = getopt(argc, argv, "o:")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind < 1) {
+        usage();
+        return 1;
+    }
+
+    std::vector<std::vector<PresetEntry>> presetsOfFiles(argc - optind);
+    std::vector<BankEntry> banks;
+
+    for (int i = optind; i < argc; ++i) {
+        const char *filepath = argv[i];
+        std::vector<PresetEntry> &presets = presetsOfFiles[i - optind];
+
+        std::string text;
+        if (!readTextFile(filepath, text)) {
+            fprintf(stderr, "Cannot read the preset file: %s\n", filepath);
+            return 1;
+        }
+
+        std::vector<BankEntry> banksOfFile;
+        if (!loadPresetsFromText(text, presets, banksOfFile)) {
+            fprintf(stderr, "Cannot load the presets of the file: %s\n", filepath);
+            return 1;
+        }
+
+        // a format without banks makes a single bank, named after the file
+        for (BankEntry &bank : banksOfFile) {
+            if (bank.name.empty()) {
+                std::string name = filepath;
+                size_t pos = name.rfind('/');
+                if (pos != name.npos)
+                    name = name.substr(pos + 1);
+                pos = name.rfind('.');
+                if (pos != name.npos && pos > 0)
+                    name.resize(pos);
+                bank.name = name;
+            }
+            banks.push_back(std::move(bank));
+        }
+    }
+
+    if (!resolveDuplicates(presetsOfFiles))
+        return 1;
+
+    WOPLFile_u wopl{createBankOfPresets(banks)};
+    if (!wopl) {
+        fprintf(stderr, "There are no presets to convert.\n");
+        return 1;
+    }
+
+    const uint16_t version = 3;
+    size_t size = WOPL_CalculateBankFileSize(wopl.get(), version);
+    std::unique_ptr<uint8_t[]> data{new uint8_t[size]};
+    if (WOPL_SaveBankToMem(wopl.get(), data.get(), size, version, 0) != 0) {
+        fprintf(stderr, "Cannot save the bank in WOPL format.\n");
+        return 1;
+    }
+
+    FILE_u outputFile;
+    FILE *fh = stdout;
+    if (strcmp(outputPath, "-")) {
+        outputFile.reset(fopen(outputPath, "wb"));
+        if (!outputFile) {
+            fprintf(stderr, "Cannot open the output file.\n");
+            return 1;
+        }
+        fh = outputFile.get();
+    }
+
+    if (fwrite(data.get(), 1, size, fh) != size || fflush(fh) != 0) {
+        fprintf(stderr, "Cannot write the output file.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+bool readTextFile(const char *filepath, std::string &text)
+{
+    FILE_u fh{fopen(filepath, "rb")};
+    if (!fh)
+        return false;
+
+    text.clear();
+    char chunk[8192];
+    for (size_t count; (count = fread(chunk, 1, sizeof(chunk), fh.get())) > 0;)
+        text.append(chunk, count);
+
+    return !ferror(fh.get());
+}
+
+bool loadPresetsFromText(const std::string &text, std::vector<PresetEntry> &presets,
+                         std::vector<BankEntry> &banks)
+{
+    size_t pos = text.find_first_not_of(" \t\r\n");
+    bool isTtl = pos != text.npos && text[pos] != '{' && text[pos] != '/';
+
+    if (isTtl) {
+        if (!loadPresetsFromTtl(text, presets, banks))
+            return false;
+    }
+    else {
+        if (!loadPresetsFromCpp(text, presets))
+            return false;
+        banks.emplace_back();
+    }
+
+    // group the presets by bank, in order of first appearance
+    std::unordered_map<std::string, size_t> banksKnown;
+    for (size_t i = 0; i < banks.size(); ++i)
+        banksKnown[banks[i].id] = i;
+
+    for (const PresetEntry &preset : presets) {
+        auto bankInsert = banksKnown.insert(
+            std::pair<std::string, size_t>{preset.bank, banks.size()});
+        if (bankInsert.second) {
+            banks.emplace_back();
+            banks.back().id = preset.bank;
+        }
+        banks[bankInsert.first->second].presets.push_back(&preset);
+    }
+
+    banks.erase(
+        std::remove_if(banks.begin(), banks.end(),
+                       [](const BankEntry &bank) { return bank.presets.empty(); }),
+        banks.end());
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void skipCppSpace(const char *&p, const char *end)
+{
+    while (p < end) {
+        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+            ++p;
+        else if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+            while (p < end && *p != '\n')
+                ++p;
+        }
+        else if (end - p >= 2 && p[0] == '/' && p[1] == '*') {
+            const char *close = std::search(p + 2, end, "*/", "*/" + 2);
+            p = (close == end) ? end : (close + 2);
+        }
+        else
+            break;
+    }
+}
+
+static bool parseCppString(const char *&p, const char *end, std::string &str)
+{
+    if (p == end || *p != '"')
+        return false;
+    ++p;
+
+    str.clear();
+    while (p < end && *p != '"') {
+        char c = *p++;
+        if (c != '\\') {
+            str.push_back(c);
+            continue;
+        }
+        if (p == end)
+            return false;
+        c = *p++;
+        switch (c) {
+        case 'n': str.push_back('\n'); break;
+        case 't': str.push_back('\t'); break;
+        case 'r': str.push_back('\r'); break;
+        case 'x': {
+            unsigned value = 0;
+            while (p < end && std::isxdigit((unsigned char)*p)) {
+                char d = *p++;
+                value = value * 16 + ((d <= '9') ? (d - '0') : ((d | 0x20) - 'a' + 10));
+            }
+            str.push_back((char)value);
+            break;
+        }
+        default:
+            if (c >= '0' && c <= '7') {
+                unsigned value = c - '0';
+                for (unsigned i = 0; i < 2 && p < end && *p >= '0' && *p <= '7'; ++i)
+                    value = value * 8 + (*p++ - '0');
+                str.push_back((char)value);
+            }
+            else
+                str.push_back(c);
+            break;
+        }
+    }
+
+    if (p == end)
+        return false;
+    ++p;
+    return true;
+}
+
+static bool parseValue(const char *&p, const char *end, unsigned index, int &value)
+{
+    std::string number;
+    while (p < end && (std::isdigit((unsigned char)*p) || (*p && strchr("+-.eE", *p))))
+        number.push_back(*p++);
+    if (number.empty())
+        return false;
+
+    const ParameterInfo &info = ParameterInfos[index];
+    double x = std::strtod(number.c_str(), nullptr);
+    value = (int)std::lround(std::max<double>(info.min, std::min<double>(info.max, x)));
+    return true;
+}
+
+bool loadPresetsFromCpp(const std::string &text, std::vector<PresetEntry> &presets)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+
+    // rows of the form {"name", {value, ...}},
+    for (;;) {
+        skipCppSpace(p, end);
+        if (p == end)
+            break;
+        if (*p++ != '{')
+            return false;
+
+        PresetEntry preset;
+        skipCppSpace(p, end);
+        if (p < end && *p == '"') {
+            if (!parseCppString(p, end, preset.name))
+                return false;
+            skipCppSpace(p, end);
+            if (p == end || *p++ != ',')
+                return false;
+            skipCppSpace(p, end);
+        }
+
+        if (p == end || *p++ != '{')
+            return false;
+        for (unsigned i = 0; i < paramCount; ++i) {
+            skipCppSpace(p, end);
+            if (!parseValue(p, end, i, preset.values[i]))
+                return false;
+            skipCppSpace(p, end);
+            if (p < end && *p == ',')
+                ++p;
+        }
+        skipCppSpace(p, end);
+        if (p == end || *p++ != '}')
+            return false;
+
+        skipCppSpace(p, end);
+        if (p < end && *p == ',') {
+            ++p;
+            skipCppSpace(p, end);
+        }
+        if (p == end || *p++ != '}')
+            return false;
+
+        skipCppSpace(p, end);
+        if (p < end && *p == ',')
+            ++p;
+
+        // the fields of the WOPL instrument, in a comment on the same line
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        static const char woplComment[] = "// wopl ";
+        const size_t woplCommentSize = sizeof(woplComment) - 1;
+        if ((size_t)(end - p) >= woplCommentSize && !memcmp(p, woplComment, woplCommentSize)) {
+            p += woplCommentSize;
+            preset.wopl.present = true;
+            while (p < end && *p != '\n') {
+                const char *field = p;
+                while (p < end && *p != '=' && *p != ' ' && *p != '\n')
+                    ++p;
+                if (p == end || *p != '=')
+                    return false;
+                std::string name(field, p++);
+                char *endp;
+                unsigned long value = std::strtoul(p, &endp, 10);
+                if (endp == p || !setWoplField(preset.wopl, name, value))
+                    return false;
+                p = endp;
+                while (p < end && (*p == ' ' || *p == '\r'))
+                    ++p;
+            }
+        }
+
+        presets.push_back(std::move(preset));
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool loadPresetsFromTtl(const std::string &text, std::vector<PresetEntry> &presets,
+                        std::vector<BankEntry> &banks)
+{
+    std::vector<TtlTriple> triples;
+    if (!parseTtl(text, triples))
+        return false;
+
+    std::unordered_map<std::string, unsigned> parameterIndices;
+    for (unsigned i = 0; i < paramCount; ++i)
+        parameterIndices[ParameterInfos[i].symbol] = i;
+
+    struct Port {
+        int index = -1;
+        std::string value;
+    };
+
+    std::unordered_map<std::string, std::string> labels;
+    std::unordered_map<std::string, std::string> bankOfPreset;
+    std::unordered_map<std::string, Port> ports;
+    std::vector<std::pair<std::string, std::vector<std::string>>> presetPorts;
+    std::unordered_map<std::string, size_t> presetsKnown;
+    std::unordered_map<std::string, WoplFields> woplOfPreset;
+    std::unordered_map<std::string, std::string> duplicateOfPreset;
+
+    for (const TtlTriple &triple : triples) {
+        const std::string &subject = triple.subject.text;
+        const std::string &predicate = triple.predicate.text;
+        const TtlTerm &object = triple.object;
+
+        if (predicate == "rdfs:label" && object.kind == TtlTerm::kString)
+            labels[subject] = object.text;
+        else if (predicate == "pset:bank")
+            bankOfPreset[subject] = object.text;
+        else if (predicate == "lv2:port") {
+            auto presetInsert = presetsKnown.insert(
+                std::pair<std::string, size_t>{subject, presetPorts.size()});
+            if (presetInsert.second)
+                presetPorts.emplace_back(subject, std::vector<std::string>{});
+            presetPorts[presetInsert.first->second].second.push_back(object.text);
+        }
+        else if (predicate == "lv2:symbol") {
+            auto it = parameterIndices.find(object.text);
+            if (it != parameterIndices.end())
+                ports[subject].index = it->second;
+        }
+        else if (predicate == "pset:value")
+            ports[subject].value = object.text;
+        else if (predicate == "wopl:duplicateOf") {
+            // in the order of the document, like the presets
+            if (presetsKnown.insert(
+                    std::pair<std::string, size_t>{subject, presetPorts.size()}).second)
+                presetPorts.emplace_back(subject, std::vector<std::string>{});
+            duplicateOfPreset[subject] = object.text;
+        }
+        else if (predicate.compare(0, 5, "wopl:") == 0 && object.kind == TtlTerm::kNumber) {
+            WoplFields &fields = woplOfPreset[subject];
+            fields.present = true;
+            if (!setWoplField(fields, predicate.substr(5), std::strtoul(object.text.c_str(), nullptr, 10)))
+                return false;
+        }
+    }
+
+    for (const auto &presetPort : presetPorts) {
+        const std::string &subject = presetPort.first;
+
+        PresetEntry preset;
+        preset.name = labels[subject];
+        preset.bank = bankOfPreset[subject];
+        preset.wopl = woplOfPreset[subject];
+        preset.id = subject;
+        preset.duplicateOf = duplicateOfPreset[subject];
+        for (unsigned i = 0; i < paramCount; ++i)
+            preset.values[i] = ParameterInfos[i].def;
+
+        for (const std::string &blank : presetPort.second) {
+            const Port &port = ports[blank];
+            if (port.index == -1)
+                continue;
+            const char *p = port.value.data();
+            const char *end = p + port.value.size();
+            if (!parseValue(p, end, port.index, preset.values[port.index]))
+                return false;
+        }
+
+        presets.push_back(std::move(preset));
+    }
+
+    // the banks, named by their labels
+    std::unordered_map<std::string, bool> banksKnown;
+    for (const PresetEntry &preset : presets) {
+        if (banksKnown.insert(std::pair<std::string, bool>{preset.bank, true}).second) {
+            banks.emplace_back();
+            banks.back().id = preset.bank;
+            banks.back().name = labels[preset.bank];
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool resolveDuplicates(std::vector<std::vector<PresetEntry>> &presetsOfFiles)
+{
+    // the presets which a duplicate refers to can be in another file
+    std::unordered_map<std::string, const PresetEntry *> presetsKnown;
+    for (const std::vector<PresetEntry> &presets : presetsOfFiles) {
+        for (const PresetEntry &preset : presets) {
+            if (!preset.id.empty() && preset.duplicateOf.empty())
+                presetsKnown[preset.id] = &preset;
+        }
+    }
+
+    for (std::vector<PresetEntry> &presets : presetsOfFiles) {
+        for (PresetEntry &preset : presets) {
+            if (preset.duplicateOf.empty())
+                continue;
+            auto it = presetsKnown.find(preset.duplicateOf);
+            if (it == presetsKnown.end()) {
+                fprintf(stderr, "The preset %s is a duplicate of %s, which is missing.\n",
+                        preset.id.c_str(), preset.duplicateOf.c_str());
+                return false;
+            }
+            std::copy(it->second->values, it->second->values + paramCount, preset.values);
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool setWoplField(WoplFields &fields, const std::string &name, unsigned long value)
+{
+    struct Field {
+        const char *name;
+        unsigned long max;
+    };
+    static const Field known[] = {
+        {"percussive", 1},
+        {"bankMsb", 127},
+        {"bankLsb", 127},
+        {"program", 127},
+        {"percussionKey", 255},
+        {"flags", 255},
+        {"delayOn", 65535},
+        {"delayOff", 65535},
+        {"named", 1},
+    };
+
+    unsigned index = 0;
+    const unsigned count = sizeof(known) / sizeof(known[0]);
+    while (index < count && name != known[index].name)
+        ++index;
+    if (index == count || value > known[index].max)
+        return false;
+
+    switch (index) {
+    case 0: fields.percussive = value != 0; break;
+    case 1: fields.bankMsb = value; break;
+    case 2: fields.bankLsb = value; break;
+    case 3: fields.program = value; break;
+    case 4: fields.percussionKey = value; break;
+    case 5: fields.flags = value; break;
+    case 6: fields.delayOnMs = value; break;
+    case 7: fields.delayOffMs = value; break;
+    case 8: fields.named = value != 0; break;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+WOPLFile *createBankOfPresets(const std::vector<BankEntry> &banks)
+{
+    struct Bank {
+        const BankEntry *entry;
+        unsigned midiBank;
+        const PresetEntry *presets[128];
+    };
+
+    // the banks of each kind, in order of their first preset
+    std::vector<Bank> banksOfKind[2];
+    std::unordered_map<unsigned, size_t> banksKnown[2];
+
+    auto addBank = [&](unsigned kind, unsigned midiBank, const BankEntry &entry) -> Bank & {
+        banksKnown[kind][midiBank] = banksOfKind[kind].size();
+        banksOfKind[kind].push_back(Bank{&entry, midiBank, {}});
+        return banksOfKind[kind].back();
+    };
+
+    // the presets with WOPL fields go to their MIDI program
+    std::vector<std::pair<const BankEntry *, const PresetEntry *>> unplaced;
+    size_t numPresets = 0;
+
+    for (const BankEntry &bank : banks) {
+        for (const PresetEntry *preset : bank.presets) {
+            ++numPresets;
+            const WoplFields &wopl = preset->wopl;
+            if (!wopl.present) {
+                unplaced.emplace_back(&bank, preset);
+                continue;
+            }
+
+            unsigned kind = wopl.percussive;
+            unsigned midiBank = (wopl.bankMsb << 7) | wopl.bankLsb;
+            auto it = banksKnown[kind].find(midiBank);
+            Bank &wbank = (it != banksKnown[kind].end()) ?
+                banksOfKind[kind][it->second] : addBank(kind, midiBank, bank);
+
+            const PresetEntry *&slot = wbank.presets[wopl.program];
+            if (slot) {
+                fprintf(stderr, "The presets \"%s\" and \"%s\" have the same MIDI program, "
+                        "the second is placed in a new bank.\n",
+                        slot->name.c_str(), preset->name.c_str());
+                unplaced.emplace_back(&bank, preset);
+                continue;
+            }
+            slot = preset;
+        }
+    }
+
+    if (numPresets == 0)
+        return nullptr;
+
+    // the other presets are numbered in order, in new melodic banks
+    if (!unplaced.empty()) {
+        fprintf(stderr, "%zu presets are numbered in order in new melodic banks, without a MIDI program of their own.\n",
+                unplaced.size());
+    }
+
+    unsigned nextMidiBank = 0;
+    const BankEntry *lastEntry = nullptr;
+    Bank *current = nullptr;
+    unsigned program = 0;
+
+    for (const std::pair<const BankEntry *, const PresetEntry *> &item : unplaced) {
+        if (!current || item.first != lastEntry || program == 128) {
+            while (banksKnown[0].count(nextMidiBank))
+                ++nextMidiBank;
+            current = &addBank(0, nextMidiBank, *item.first);
+            lastEntry = item.first;
+            program = 0;
+        }
+        current->presets[program++] = item.second;
+    }
+
+    // the format wants a bank of each kind, which can be left blank
+    unsigned numMelodic = std::max<size_t>(1, banksOfKind[0].size());
+    unsigned numPercussive = std::max<size_t>(1, banksOfKind[1].size());
+    if (numMelodic > 65535 || numPercussive > 65535)
+        return nullptr;
+
+    WOPLFile_u wopl{WOPL_Init(numMelodic, numPercussive)};
+    if (!wopl)
+        return nullptr;
+
+    // the settings of the chip are those of the first preset
+    const PresetEntry &first = *banks.front().presets.front();
+    wopl->opl_flags =
+        (first.values[paramDeepVibrato] ? WOPL_FLAG_DEEP_VIBRATO : 0) |
+        (first.values[paramDeepTremolo] ? WOPL_FLAG_DEEP_TREMOLO : 0);
+    wopl->volume_model = first.values[paramVolumeModel];
+
+    bool sameSettings = true;
+    for (const BankEntry &bank : banks) {
+        for (const PresetEntry *preset : bank.presets) {
+            sameSettings = sameSettings &&
+                preset->values[paramDeepVibrato] == first.values[paramDeepVibrato] &&
+                preset->values[paramDeepTremolo] == first.values[paramDeepTremolo] &&
+                preset->values[paramVolumeModel] == first.values[paramVolumeModel];
+        }
+    }
+    if (!sameSettings)
+        fprintf(stderr, "The presets have different chip settings, keeping those of the first.\n");
+
+    for (unsigned kind = 0; kind < 2; ++kind) {
+        WOPLBank *wbanks = kind ? wopl->banks_percussive : wopl->banks_melodic;
+        unsigned count = kind ? numPercussive : numMelodic;
+
+        for (unsigned b = 0; b < count; ++b) {
+            WOPLBank &wbank = wbanks[b];
+            const Bank *bank = (b < banksOfKind[kind].size()) ? &banksOfKind[kind][b] : nullptr;
+
+            if (bank) {
+                strncpy(wbank.bank_name, bank->entry->name.c_str(), sizeof(wbank.bank_name) - 1);
+                wbank.bank_midi_msb = bank->midiBank >> 7;
+                wbank.bank_midi_lsb = bank->midiBank & 127;
+            }
+
+            for (unsigned i = 0; i < 128; ++i) {
+                WOPLInstrument &inst = wbank.ins[i];
+                if (bank && bank->presets[i])
+                    convertPreset(*bank->presets[i], inst);
+                else
+                    inst.inst_flags = WOPL_Ins_IsBlank;
+            }
+        }
+    }
+
+    return wopl.release();
+}
+
+void convertPreset(const PresetEntry &preset, WOPLInstrument &inst)
+{
+    memset(&inst, 0, sizeof(inst));
+
+    const WoplFields &wopl = preset.wopl;
+    if (wopl.named) {
+        if (preset.name.size() >= sizeof(inst.inst_name))
+            fprintf(stderr, "The name \"%s\" is truncated to %zu characters.\n",
+                    preset.name.c_str(), sizeof(inst.inst_name) - 1);
+        strncpy(inst.inst_name, preset.name.c_str(), sizeof(inst.inst_name) - 1);
+    }
+
+    inst.percussion_key_number = wopl.percussionKey;
+    inst.inst_flags = wopl.flags;
+    inst.delay_on_ms = wopl.delayOnMs;
+    inst.delay_off_ms = wopl.delayOffMs;
+
+    for (unsigned i = paramAlgorithm; i < paramCount; ++i)
+        SetInstrumentParameter(inst, i, preset.values[i]);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+
+class TtlParser {
+public:
+    TtlParser(const std::string &text, std::vector<TtlTriple> &triples)
+        : p_(text.data()), end_(text.data() + text.size()), triples_(triples) {}
+
+    bool parse();
+
+private:
+    void skipSpace();
+    bool skipDirective();
+    bool parsePredicateObjectList(const TtlTerm &subject);
+    bool parseObject(TtlTerm &object);
+    bool parseTerm(TtlTerm &term);
+    bool parseString(std::string &str);
+    static void appendUtf8(std::string &str, unsigned long c);
+
+    const char *p_;
+    const char *end_;
+    unsigned blankCount_ = 0;
+    std::vector<TtlTriple> &triples_;
+};
+
+bool TtlParser::parse()
+{
+    for (;;) {
+        skipSpace();
+        if (p_ == end_)
+            return true;
+
+        if (*p_ == '@') {
+            if (!skipDirective())
+                return false;
+            continue;
+        }
+
+        TtlTerm subject;
+        if (!parseObject(subject))
+            return false;
+        if (!parsePredicateObjectList(subject))
+            return false;
+
+        skipSpace();
+        if (p_ == end_ || *p_++ != '.')
+            return false;
+    }
+}
+
+void TtlParser::skipSpace()
+{
+    while (p_ < end_) {
+        if (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n')
+            ++p_;
+        else if (*p_ == '#') {
+            while (p_ < end_ && *p_ != '\n')
+                ++p_;
+        }
+        else
+            break;
+    }
+}
+
+bool TtlParser::skipDirective()
+{
+    // the prefixes are not expanded, skip until the IRI and the final dot
+    while (p_ < end_ && *p_ != '<')
+        ++p_;
+    while (p_ < end_ && *p_ != '>')
+        ++p_;
+    if (p_ == end_)
+        return false;
+    ++p_;
+
+    skipSpace();
+    return p_ < end_ && *p_++ == '.';
+}
+
+bool TtlParser::parsePredicateObjectList(const TtlTerm &subject)
+{
+    for (;;) {
+        skipSpace();
+        if (p_ == end_ || *p_ == '.' || *p_ == ']')
+            return true;
+
+        TtlTerm predicate;
+        if (!parseTerm(predicate))
+            return false;
+
+        for (;;) {
+            TtlTriple triple;
+            if (!parseObject(triple.object))
+                return false;
+            triple.subject = subject;
+            triple.predicate = predicate;
+            triples_.push_back(std::move(triple));
+
+            skipSpace();
+            if (p_ == end_ || *p_ != ',')
+                break;
+            ++p_;
+        }
+
+        skipSpace();
+        if (p_ == end_ || *p_ != ';')
+            return true;
+        while (p_ < end_ && *p_ == ';') {
+            ++p_;
+            skipSpace();
+        }
+    }
+}
+
+bool TtlParser::parseObject(TtlTerm &object)
+{
+    skipSpace();
+    if (p_ == end_)
+        return false;
+
+    if (*p_ != '[')
+        return parseTerm(object);
+
+    ++p_;
+    object.kind = TtlTerm::kBlank;
+    object.text = "_:b" + std::to_string(blankCount_++);
+
+    TtlTerm subject = object;
+    if (!parsePredicateObjectList(subject))
+        return false;
+
+    skipSpace();
+    if (p_ == end_ || *p_++ != ']')
+        return false;
+    return true;
+}
+
+bool TtlParser::parseTerm(TtlTerm &term)
+{
+    skipSpace();
+    if (p_ == end_)
+        return false;
+
+    term.text.clear();
+    char c = *p_;
+
+    if (c == '<') {
+        term.kind = TtlTerm::kName;
+        while (p_ < end_ && *p_ != '>')
+            term.text.push_back(*p_++);
+        if (p_ == end_)
+            return false;
+        term.text.push_back(*p_++);
+        return true;
+    }
+
+    if (c == '"' || c == '\'') {
+        term.kind = TtlTerm::kString;
+        if (!parseString(term.text))
+            return false;
+        // skip the language tag or the datatype
+        if (p_ < end_ && *p_ == '@') {
+            ++p_;
+            while (p_ < end_ && (std::isalnum((unsigned char)*p_) || *p_ == '-'))
+                ++p_;
+        }
+        else if (end_ - p_ >= 2 && p_[0] == '^' && p_[1] == '^') {
+            p_ += 2;
+            TtlTerm datatype;
+            return parseTerm(datatype);
+        }
+        return true;
+    }
+
+    if (std::isdigit((unsigned char)c) || c == '+' || c == '-' ||
+        (c == '.' && end_ - p_ >= 2 && std::isdigit((unsigned char)p_[1]))) {
+        term.kind = TtlTerm::kNumber;
+        while (p_ < end_ && (std::isdigit((unsigned char)*p_) || strchr("+-eE", *p_) ||
+                             (*p_ == '.' && end_ - p_ >= 2 && std::isdigit((unsigned char)p_[1]))))
+            term.text.push_back(*p_++);
+        return true;
+    }
+
+    // prefixed name, or keyword; a dot only belongs to the name if it is not the last
+    term.kind = TtlTerm::kName;
+    while (p_ < end_) {
+        char c = *p_;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || strchr(";,[]()\"#", c))
+            break;
+        if (c == '.' && (end_ - p_ < 2 || !(std::isalnum((unsigned char)p_[1]) || strchr("_-:", p_[1]))))
+            break;
+        term.text.push_back(c);
+        ++p_;
+    }
+    return !term.text.empty();
+}
+
+bool TtlParser::parseString(std::string &str)
+{
+    char quote = *p_;
+    bool isLong = end_ - p_ >= 3 && p_[1] == quote && p_[2] == quote;
+    p_ += isLong ? 3 : 1;
+
+    for (;;) {
+        if (p_ == end_)
+            return false;
+
+        char c = *p_;
+        if (c == quote) {
+            if (!isLong) {
+                ++p_;
+                return true;
+            }
+            // the string ends at the last of 3 or more quotes
+            if (end_ - p_ >= 3 && p_[1] == quote && p_[2] == quote &&
+                (end_ - p_ == 3 || p_[3] != quote)) {
+                p_ += 3;
+                return true;
+            }
+            str.push_back(c);
+            ++p_;
+            continue;
+        }
+
+        if (c != '\\') {
+            if (!isLong && (c == '\n' || c == '\r'))
+                return false;
+            str.push_back(c);
+            ++p_;
+            continue;
+        }
+
+        if (end_ - p_ < 2)
+            return false;
+        c = p_[1];
+        p_ += 2;
+        switch (c) {
+        case 't': str.push_back('\t'); break;
+        case 'b': str.push_back('\b'); break;
+        case 'n': str.push_back('\n'); break;
+        case 'r': str.push_back('\r'); break;
+        case 'f': str.push_back('\f'); break;
+        case '"': case '\'': case '\\': str.push_back(c); break;
+        case 'u': case 'U': {
+            unsigned digits = (c == 'u') ? 4 : 8;
+            if ((unsigned)(end_ - p_) < digits)
+                return false;
+            std::string hex(p_, digits);
+            char *endp;
+            unsigned long code = std::strtoul(hex.c_str(), &endp, 16);
+            if (*endp != '\0')
+                return false;
+            appendUtf8(str, code);
+            p_ += digits;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+void TtlParser::appendUtf8(std::string &str, unsigned long c)
+{
+    if (c < 0x80)
+        str.push_back((char)c);
+    else if (c < 0x800) {
+        str.push_back((char)(0xc0 | (c >> 6)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+    }
+    else if (c < 0x10000) {
+        str.push_back((char)(0xe0 | (c >> 12)));
+        str.push_back((char)(0x80 | ((c >> 6) & 0x3f)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+    }
+    else {
+        str.push_back((char)(0xf0 | ((c >> 18) & 0x07)));
+        str.push_back((char)(0x80 | ((c >> 12) & 0x3f)));
+        str.push_back((char)(0x80 | ((c >> 6) & 0x3f)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+    }
+}
+
+} // namespace
+
+bool parseTtl(const std::string &text, std::vector<TtlTriple> &triples)
+{
+    TtlParser parser(text, triples);
+    return parser.parse();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "../thirdparty/libADLMIDI/src/wopl/wopl_file.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+
+//
+struct FILE_deleter { void operator()(FILE *x) const noexcept { fclose(x); } };
+typedef std::unique_ptr<FILE, FILE_deleter> FILE_u;
+
+//
+struct WOPL_deleter { void operator()(WOPLFile *x) const noexcept { WOPL_Free(x); } };
+typedef std::unique_ptr<WOPLFile, WOPL_deleter> WOPLFile_u;
+
+//
+// the placement and the fields of the WOPL instrument which are not
+// parameters, present if bank2preset has written them with -w
+struct WoplFields {
+    bool present = false;
+    bool percussive = false;
+    unsigned bankMsb = 0;
+    unsigned bankLsb = 0;
+    unsigned program = 0;
+    unsigned percussionKey = 0;
+    unsigned flags = 0;
+    unsigned delayOnMs = 0;
+    unsigned delayOffMs = 0;
+    // false if the instrument had no name, and bank2preset named it
+    bool named = true;
+};
+
+bool setWoplField(WoplFields &fields, const std::string &name, unsigned long value);
+
+//
+struct PresetEntry {
+    std::string name;
+    // the identifier of the bank, empty if the format has no banks
+    std::string bank;
+    int values[paramCount];
+    WoplFields wopl;
+    // the identifier of the preset, empty if the format has none
+    std::string id;
+    // the identifier of the preset which has the values of this duplicate,
+    // written by bank2preset with -d and -w
+    std::string duplicateOf;
+};
+
+struct BankEntry {
+    std::string id;
+    std::string name;
+    std::vector<const PresetEntry *> presets;
+};
+
+//
+bool readTextFile(const char *filepath, std::string &text);
+bool loadPresetsFromText(const std::string &text, std::vector<PresetEntry> &presets,
+                         std::vector<BankEntry> &banks);
+bool loadPresetsFromCpp(const std::string &text, std::vector<PresetEntry> &presets);
+bool loadPresetsFromTtl(const std::string &text, std::vector<PresetEntry> &presets,
+                        std::vector<BankEntry> &banks);
+bool resolveDuplicates(std::vector<std::vector<PresetEntry>> &presetsOfFiles);
+
+//
+WOPLFile *createBankOfPresets(const std::vector<BankEntry> &banks);
+void convertPreset(const PresetEntry &preset, WOPLInstrument &inst);
+
+//
+// a small reader for the Turtle documents written by bank2preset:
+// prefixed names are not expanded, and the collections are not supported
+struct TtlTerm {
+    enum Kind { kName, kString, kNumber, kBlank };
+    Kind kind = kName;
+    std::string text;
+};
+
+struct TtlTriple {
+    TtlTerm subject;
+    TtlTerm predicate;
+    TtlTerm object;
+};
+
+bool parseTtl(const std::string &text, std::vector<TtlTriple> &triples);
@@ -0,0 +1,48 @@
+#include "random_block.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+
+void randomBlock(std::mt19937 &rng, unsigned frames, RandomBlock &block, bool allParameters)
+{
+    static const uint8_t controllers[] = {1, 7, 10, 11, 64, 71, 74};
+
+    std::uniform_int_distribution<unsigned> data(0, 127);
+    block.eventCount = std::uniform_int_distribution<unsigned>(0, kRandomBlockMaxEvents / 2)(rng);
+
+    for (unsigned i = 0; i < block.eventCount; ++i) {
+        MidiEvent &event = block.events[i];
+        event = MidiEvent{};
+        event.frame = (i * frames) / kRandomBlockMaxEvents;
+        event.size = 3;
+        event.data[1] = data(rng);
+        event.data[2] = data(rng);
+        switch (std::uniform_int_distribution<unsigned>(0, 5)(rng)) {
+        case 0:
+        case 1:
+            event.data[0] = 0x90;
+            break;
+        case 2:
+            event.data[0] = 0x80;
+            break;
+        case 3:
+            event.data[0] = 0xb0;
+            event.data[1] = controllers[data(rng) % sizeof(controllers)];
+            break;
+        case 4:
+            event.data[0] = 0xe0;
+            break;
+        case 5:
+            event.data[0] = (data(rng) & 1) ? 0xa0 : 0xd0;
+            break;
+        }
+    }
+
+    block.param = -1;
+    if (std::uniform_int_distribution<unsigned>(0, 3)(rng) == 0) {
+        unsigned index = std::uniform_int_distribution<unsigned>(0, paramCount - 1)(rng);
+        const ParameterInfo &info = ParameterInfos[index];
+        if (allParameters || (info.hints & kParameterIsAutomable)) {
+            block.param = index;
+            block.value = std::uniform_int_distribution<int>(info.min, info.max)(rng);
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "DistrhoPlugin.hpp"
+#include <random>
+
+// the events of a block, as a host sends in steady state
+enum { kRandomBlockMaxEvents = 8 };
+
+struct RandomBlock {
+    MidiEvent events[kRandomBlockMaxEvents];
+    unsigned eventCount = 0;
+    // automation, a parameter index or -1, and its value
+    int param = -1;
+    float value = 0;
+};
+
+// random notes, controllers, bends and aftertouch, and at times the
+// automation of a parameter, with the frames of the events in order
+//  - with `allParameters`, the parameters which are not automatable are
+//    written too, as hosts do with the control ports of LV2
+void randomBlock(std::mt19937 &rng, unsigned frames, RandomBlock &block, bool allParameters = false);
@@ -0,0 +1,677 @@
+#include "render.h"
+#include "../../sources/plugin/CoreMiniOPL3.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: miniopl3-render [options] <midi-file>\n"
+        "  -o <file>      output file, - for standard output (default: -)\n"
+        "  -f <format>    output format: wav, raw, digest (default: wav)\n"
+        "  -g <file>      compare the output with a golden digest, instead of writing it\n"
+        "  -E <epsilon>   tolerance of the comparison of levels (default: 1e-4)\n"
+        "  -x             require the comparison to be bit-exact\n"
+        "  -r <rate>      sample rate (default: 44100)\n"
+        "  -b <bank>      bank file in WOPL format\n"
+        "  -p <number>    program number in the bank, or embedded program (default: 0)\n"
+        "  -P <file>      preset file, in the format printed by bank2preset\n"
+        "  -c <chips>     number of chips\n"
+        "  -a <number>    algorithm, replacing the one of the program\n"
+        "  -e <emulator>  emulator core: nuked, nuked174, dosbox (default: dosbox)\n"
+        "  -B <frames>    block size (default: 512)\n"
+        "  -t <seconds>   duration of the tail after the last event (default: 2)\n");
+}
+
+static int emulatorByName(const char *name)
+{
+    if (!strcmp(name, "nuked"))
+        return ADLMIDI_EMU_NUKED;
+    if (!strcmp(name, "nuked174"))
+        return ADLMIDI_EMU_NUKED_174;
+    if (!strcmp(name, "dosbox"))
+        return ADLMIDI_EMU_DOSBOX;
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = "-";
+    OutputFormat format = kOutputWav;
+    unsigned sampleRate = 44100;
+    const char *bankPath = nullptr;
+    unsigned program = 0;
+    const char *presetPath = nullptr;
+    int numChips = -1;
+    int algorithm = -1;
+    int emulator = ADLMIDI_EMU_DOSBOX;
+    unsigned blockSize = 512;
+    double tail = 2.0;
+    const char *goldenPath = nullptr;
+    float epsilon = 1e-4f;
+    bool exactOnly = false;
+
+    for (int c; (c = getopt(argc, argv, "o:f:g:E:xr:b:p:P:c:a:e:B:t:")) != -1;) {
+        switch (c) {
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'f':
+            if (!strcmp(optarg, "wav"))
+                format = kOutputWav;
+            else if (!strcmp(optarg, "raw"))
+                format = kOutputRaw;
+            else if (!strcmp(optarg, "digest"))
+                format = kOutputDigest;
+            else {
+                fprintf(stderr, "Unknown output format: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'g':
+            goldenPath = optarg;
+            format = kOutputDigest;
+            break;
+        case 'E':
+            epsilon = std::atof(optarg);
+            break;
+        case 'x':
+            exactOnly = true;
+            break;
+        case 'r':
+            sampleRate = std::atoi(optarg);
+            break;
+        case 'b':
+            bankPath = optarg;
+            break;
+        case 'p':
+            program = std::atoi(optarg);
+            break;
+        case 'P':
+            presetPath = optarg;
+            break;
+        case 'c':
+            numChips = std::atoi(optarg);
+            break;
+        case 'a':
+            algorithm = std::atoi(optarg);
+            break;
+        case 'e':
+            emulator = emulatorByName(optarg);
+            if (emulator == -1) {
+                fprintf(stderr, "Unknown emulator: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'B':
+            blockSize = std::atoi(optarg);
+            break;
+        case 't':
+            tail = std::atof(optarg);
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        usage();
+        return 1;
+    }
+
+    if (sampleRate == 0 || blockSize == 0 || tail < 0 || !(epsilon >= 0)) {
+        fprintf(stderr, "Invalid rendering settings.\n");
+        return 1;
+    }
+
+    const char *midiPath = argv[optind];
+
+    OutputDigest golden;
+    if (goldenPath && !readOutputDigest(goldenPath, golden)) {
+        fprintf(stderr, "Cannot load the golden digest.\n");
+        return 1;
+    }
+
+    //
+    float values[paramCount];
+    if (presetPath) {
+        if (!loadPresetFromText(presetPath, values)) {
+            fprintf(stderr, "Cannot load the preset file.\n");
+            return 1;
+        }
+    }
+    else if (bankPath) {
+        if (!loadPresetFromBank(bankPath, program, values)) {
+            fprintf(stderr, "Cannot load the program from the bank file.\n");
+            return 1;
+        }
+    }
+    else {
+        if (program >= programCount) {
+            fprintf(stderr, "There is no embedded program %u.\n", program);
+            return 1;
+        }
+        std::copy(EmbeddedPrograms[program].values,
+                  EmbeddedPrograms[program].values + paramCount, values);
+    }
+
+    if (numChips != -1)
+        values[paramNumChips] = numChips;
+    if (algorithm != -1)
+        values[paramAlgorithm] = algorithm;
+
+    //
+    std::vector<TimedMidiMessage> messages;
+    if (!readMidiFile(midiPath, messages)) {
+        fprintf(stderr, "Cannot load the MIDI file.\n");
+        return 1;
+    }
+
+    double duration = tail;
+    if (!messages.empty())
+        duration += messages.back().time;
+    uint64_t totalFrames = (uint64_t)(duration * sampleRate);
+
+    //
+    FILE_u outputFile;
+    FILE *fh = stdout;
+    if (strcmp(outputPath, "-")) {
+        outputFile.reset(fopen(outputPath, "wb"));
+        if (!outputFile) {
+            fprintf(stderr, "Cannot open the output file.\n");
+            return 1;
+        }
+        fh = outputFile.get();
+    }
+
+    if (!writeOutputHeader(fh, format, sampleRate, totalFrames)) {
+        fprintf(stderr, "Cannot write the output file.\n");
+        return 1;
+    }
+
+    //
+    CoreMiniOPL3 core;
+    core.setSampleRate(sampleRate);
+    core.setEmulator(emulator);
+    core.setParameterValues(values);
+    core.activate();
+
+    std::unique_ptr<float[]> buffer{new float[2 * blockSize]};
+    float *outputs[] = {&buffer[0], &buffer[blockSize]};
+    std::vector<MidiEvent> events;
+    events.reserve(messages.size());
+    OutputDigest digest;
+
+    size_t messageIndex = 0;
+    for (uint64_t frame = 0; frame < totalFrames;) {
+        unsigned frames = blockSize;
+        if (frames > totalFrames - frame)
+            frames = totalFrames - frame;
+
+        events.clear();
+        for (; messageIndex < messages.size(); ++messageIndex) {
+            const TimedMidiMessage &msg = messages[messageIndex];
+            uint64_t msgFrame = (uint64_t)(msg.time * sampleRate);
+            if (msgFrame >= frame + frames)
+                break;
+            MidiEvent event = {};
+            event.frame = msgFrame - frame;
+            event.size = msg.size;
+            std::memcpy(event.data, msg.data, msg.size);
+            events.push_back(event);
+        }
+
+        core.run(outputs, frames, events.data(), events.size());
+
+        if (format == kOutputDigest)
+            updateOutputDigest(digest, outputs[0], outputs[1], frames);
+        else if (!writeOutputFrames(fh, outputs[0], outputs[1], frames)) {
+            fprintf(stderr, "Cannot write the output file.\n");
+            return 1;
+        }
+
+        frame += frames;
+    }
+
+    if (format == kOutputDigest) {
+        finishOutputDigest(digest);
+        if (goldenPath) {
+            DigestMatch match = compareOutputDigests(digest, golden, epsilon);
+            const char *result = (match == kDigestExact) ? "exact" :
+                (match == kDigestWithinTolerance) ? "within tolerance" : "different";
+            fprintf(fh, "%s: %s\n", goldenPath, result);
+            if (match == kDigestDifferent || (exactOnly && match != kDigestExact))
+                return 1;
+        }
+        else if (!writeOutputDigest(fh, digest)) {
+            fprintf(stderr, "Cannot write the output file.\n");
+            return 1;
+        }
+    }
+
+    if (fflush(fh) != 0) {
+        fprintf(stderr, "Cannot write the output file.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static bool readVarLen(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        if (p == end)
+            return false;
+        uint8_t byte = *p++;
+        value = (value << 7) | (byte & 0x7f);
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static uint32_t readBE(const uint8_t *p, unsigned size)
+{
+    uint32_t value = 0;
+    for (unsigned i = 0; i < size; ++i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+bool readMidiFile(const char *filepath, std::vector<TimedMidiMessage> &messages)
+{
+    FILE_u fh{fopen(filepath, "rb")};
+    if (!fh)
+        return false;
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[8192];
+    for (size_t count; (count = fread(chunk, 1, sizeof(chunk), fh.get())) > 0;)
+        data.insert(data.end(), chunk, chunk + count);
+    if (ferror(fh.get()))
+        return false;
+
+    const uint8_t *p = data.data();
+    const uint8_t *end = p + data.size();
+
+    if (end - p < 14 || memcmp(p, "MThd", 4) || readBE(p + 4, 4) < 6)
+        return false;
+
+    unsigned numTracks = readBE(p + 10, 2);
+    unsigned division = readBE(p + 12, 2);
+    uint32_t headerSize = readBE(p + 4, 4);
+    if ((size_t)(end - p - 8) < headerSize)
+        return false;
+    p += 8 + headerSize;
+
+    // events of all tracks, with their tick position
+    struct TickEvent {
+        uint64_t tick;
+        uint32_t tempo; // nonzero for a tempo change
+        TimedMidiMessage msg;
+    };
+    std::vector<TickEvent> tickEvents;
+
+    for (unsigned track = 0; track < numTracks && end - p >= 8;) {
+        uint32_t chunkSize = readBE(p + 4, 4);
+        bool isTrack = !memcmp(p, "MTrk", 4);
+        p += 8;
+        if ((uint32_t)(end - p) < chunkSize)
+            return false;
+        const uint8_t *chunkEnd = p + chunkSize;
+
+        if (!isTrack) {
+            p = chunkEnd;
+            continue;
+        }
+
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+
+        while (p < chunkEnd) {
+            uint32_t delta;
+            if (!readVarLen(p, chunkEnd, delta) || p == chunkEnd)
+                return false;
+            tick += delta;
+
+            uint8_t status = *p;
+            if (status & 0x80)
+                ++p;
+            else if (runningStatus)
+                status = runningStatus;
+            else
+                return false;
+
+            if (status == 0xff) {
+                if (p == chunkEnd)
+                    return false;
+                uint8_t type = *p++;
+                uint32_t length;
+                if (!readVarLen(p, chunkEnd, length) || (uint32_t)(chunkEnd - p) < length)
+                    return false;
+                if (type == 0x51 && length == 3) {
+                    TickEvent event = {};
+                    event.tick = tick;
+                    event.tempo = readBE(p, 3);
+                    if (event.tempo != 0)
+                        tickEvents.push_back(event);
+                }
+                p += length;
+                if (type == 0x2f)
+                    break;
+            }
+            else if (status == 0xf0 || status == 0xf7) {
+                uint32_t length;
+                if (!readVarLen(p, chunkEnd, length) || (uint32_t)(chunkEnd - p) < length)
+                    return false;
+                p += length;
+                runningStatus = 0;
+            }
+            else if (status < 0xf0) {
+                runningStatus = status;
+                unsigned size = ((status & 0xe0) == 0xc0) ? 2 : 3;
+                if ((unsigned)(chunkEnd - p) < size - 1)
+                    return false;
+                TickEvent event = {};
+                event.tick = tick;
+                event.msg.size = size;
+                event.msg.data[0] = status;
+                for (unsigned i = 1; i < size; ++i)
+                    event.msg.data[i] = *p++;
+                tickEvents.push_back(event);
+            }
+            else
+                return false;
+        }
+
+        p = chunkEnd;
+        ++track;
+    }
+
+    std::stable_sort(
+        tickEvents.begin(), tickEvents.end(),
+        [](const TickEvent &a, const TickEvent &b) -> bool { return a.tick < b.tick; });
+
+    // convert ticks to seconds, following the tempo changes
+    double secondsPerTick;
+    bool smpte = (division & 0x8000) != 0;
+    if (smpte) {
+        unsigned fps = -(int8_t)(division >> 8);
+        unsigned ticksPerFrame = division & 0xff;
+        if (fps == 0 || ticksPerFrame == 0)
+            return false;
+        secondsPerTick = 1.0 / (fps * ticksPerFrame);
+    }
+    else {
+        if (division == 0)
+            return false;
+        secondsPerTick = 500000e-6 / division;
+    }
+
+    messages.clear();
+    messages.reserve(tickEvents.size());
+
+    double time = 0;
+    uint64_t lastTick = 0;
+    for (const TickEvent &event : tickEvents) {
+        time += (event.tick - lastTick) * secondsPerTick;
+        lastTick = event.tick;
+        if (event.tempo != 0) {
+            if (!smpte)
+                secondsPerTick = event.tempo * 1e-6 / division;
+            continue;
+        }
+        TimedMidiMessage msg = event.msg;
+        msg.time = time;
+        messages.push_back(msg);
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool loadPresetFromText(const char *filepath, float values[])
+{
+    FILE_u fh{fopen(filepath, "rb")};
+    if (!fh)
+        return false;
+
+    std::string text;
+    char chunk[1024];
+    for (size_t count; (count = fread(chunk, 1, sizeof(chunk), fh.get())) > 0;)
+        text.append(chunk, count);
+
+    // skip the quoted name, if any
+    size_t pos = 0;
+    size_t quote = text.find('"');
+    if (quote != text.npos) {
+        pos = quote + 1;
+        while (pos < text.size() && text[pos] != '"')
+            pos += (text[pos] == '\\') ? 2 : 1;
+        ++pos;
+    }
+
+    unsigned count = 0;
+    const char *p = text.c_str() + std::min(pos, text.size());
+    while (*p && count < paramCount) {
+        if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            char *endp;
+            values[count++] = std::strtof(p, &endp);
+            p = endp;
+        }
+        else
+            ++p;
+    }
+
+    return count == paramCount;
+}
+
+bool loadPresetFromBank(const char *filepath, unsigned program, float values[])
+{
+    FILE_u fh{fopen(filepath, "rb")};
+    if (!fh)
+        return false;
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[8192];
+    for (size_t count; (count = fread(chunk, 1, sizeof(chunk), fh.get())) > 0;)
+        data.insert(data.end(), chunk, chunk + count);
+
+    WOPLFile_u wopl{WOPL_LoadBankFromMem(data.data(), data.size(), nullptr)};
+    if (!wopl)
+        return false;
+
+    // programs are numbered like the presets of bank2preset
+    const WOPLInstrument *found = nullptr;
+    unsigned index = 0;
+    unsigned numBanks = wopl->banks_count_melodic + wopl->banks_count_percussion;
+    for (unsigned b = 0; b < numBanks && !found; ++b) {
+        const WOPLBank &bank = (b < wopl->banks_count_melodic) ?
+            wopl->banks_melodic[b] :
+            wopl->banks_percussive[b - wopl->banks_count_melodic];
+        for (unsigned i = 0; i < 128 && !found; ++i) {
+            const WOPLInstrument &inst = bank.ins[i];
+            if ((inst.inst_flags & WOPL_Ins_IsBlank) == 0 && index++ == program)
+                found = &inst;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    for (unsigned i = 0; i < paramCount; ++i)
+        values[i] = ParameterInfos[i].def;
+    for (unsigned i = paramAlgorithm; i < paramCount; ++i)
+        values[i] = GetInstrumentParameter(*found, i);
+
+    values[paramDeepVibrato] = (wopl->opl_flags & WOPL_FLAG_DEEP_VIBRATO) != 0;
+    values[paramDeepTremolo] = (wopl->opl_flags & WOPL_FLAG_DEEP_TREMOLO) != 0;
+    values[paramVolumeModel] = wopl->volume_model;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void storeLE(uint8_t *p, uint32_t value, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+        p[i] = (value >> (8 * i)) & 0xff;
+}
+
+bool writeOutputHeader(FILE *fh, OutputFormat format, unsigned sampleRate, uint64_t frames)
+{
+    if (format != kOutputWav)
+        return true;
+
+    const unsigned channels = 2;
+    const unsigned bytesPerFrame = channels * sizeof(float);
+    uint64_t dataSize = frames * bytesPerFrame;
+    if (dataSize > 0xffffffffu - 58)
+        return false;
+
+    uint8_t header[58];
+    memcpy(header, "RIFF", 4);
+    storeLE(header + 4, (uint32_t)dataSize + 50, 4);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    storeLE(header + 16, 18, 4);
+    storeLE(header + 20, 3, 2); // IEEE float
+    storeLE(header + 22, channels, 2);
+    storeLE(header + 24, sampleRate, 4);
+    storeLE(header + 28, sampleRate * bytesPerFrame, 4);
+    storeLE(header + 32, bytesPerFrame, 2);
+    storeLE(header + 34, 8 * sizeof(float), 2);
+    storeLE(header + 36, 0, 2);
+    memcpy(header + 38, "fact", 4);
+    storeLE(header + 42, 4, 4);
+    storeLE(header + 46, (uint32_t)frames, 4);
+    memcpy(header + 50, "data", 4);
+    storeLE(header + 54, (uint32_t)dataSize, 4);
+
+    return fwrite(header, sizeof(header), 1, fh) == 1;
+}
+
+bool writeOutputFrames(FILE *fh, const float *left, const float *right, unsigned frames)
+{
+    uint8_t buffer[1024 * 2 * sizeof(float)];
+
+    for (unsigned index = 0; index < frames;) {
+        unsigned count = std::min(frames - index, 1024u);
+        for (unsigned i = 0; i < count; ++i) {
+            uint32_t l, r;
+            memcpy(&l, &left[index + i], sizeof(float));
+            memcpy(&r, &right[index + i], sizeof(float));
+            storeLE(buffer + 8 * i, l, 4);
+            storeLE(buffer + 8 * i + 4, r, 4);
+        }
+        if (fwrite(buffer, 8 * count, 1, fh) != 1)
+            return false;
+        index += count;
+    }
+
+    return true;
+}
+
+static void hashBytes(uint64_t &hash, uint32_t value, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i) {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= 0x100000001b3u;
+    }
+}
+
+void updateOutputDigest(OutputDigest &digest, const float *left, const float *right, unsigned frames)
+{
+    for (unsigned i = 0; i < frames; ++i) {
+        const float samples[2] = {left[i], right[i]};
+        for (unsigned c = 0; c < 2; ++c) {
+            uint32_t bits;
+            memcpy(&bits, &samples[c], sizeof(float));
+            hashBytes(digest.exact, bits, 4);
+
+            digest.sumSquares[c] += (double)samples[c] * samples[c];
+            digest.peak[c] = std::max(digest.peak[c], std::fabs(samples[c]));
+        }
+
+        ++digest.frames;
+        if (++digest.blockFrames == kDigestBlockFrames)
+            finishOutputDigest(digest);
+    }
+}
+
+void finishOutputDigest(OutputDigest &digest)
+{
+    if (digest.blockFrames == 0)
+        return;
+
+    DigestBlock block;
+    for (unsigned c = 0; c < 2; ++c) {
+        block.rms[c] = (float)std::sqrt(digest.sumSquares[c] / digest.blockFrames);
+        block.peak[c] = digest.peak[c];
+        digest.sumSquares[c] = 0;
+        digest.peak[c] = 0;
+    }
+    digest.blocks.push_back(block);
+    digest.blockFrames = 0;
+}
+
+bool writeOutputDigest(FILE *fh, const OutputDigest &digest)
+{
+    fprintf(fh, "exact %016llx %llu\n",
+            (unsigned long long)digest.exact, (unsigned long long)digest.frames);
+    for (const DigestBlock &block : digest.blocks) {
+        fprintf(fh, "block %.7f %.7f %.7f %.7f\n",
+                block.rms[0], block.rms[1], block.peak[0], block.peak[1]);
+    }
+    return !ferror(fh);
+}
+
+bool readOutputDigest(const char *filepath, OutputDigest &digest)
+{
+    FILE_u fh{fopen(filepath, "rb")};
+    if (!fh)
+        return false;
+
+    digest = OutputDigest{};
+
+    unsigned long long exact, frames;
+    if (fscanf(fh.get(), " exact %llx %llu", &exact, &frames) != 2)
+        return false;
+    digest.exact = exact;
+    digest.frames = frames;
+
+    DigestBlock block;
+    while (fscanf(fh.get(), " block %f %f %f %f",
+                  &block.rms[0], &block.rms[1], &block.peak[0], &block.peak[1]) == 4)
+        digest.blocks.push_back(block);
+
+    return feof(fh.get()) && !ferror(fh.get());
+}
+
+DigestMatch compareOutputDigests(const OutputDigest &digest, const OutputDigest &golden, float epsilon)
+{
+    if (digest.frames != golden.frames || digest.blocks.size() != golden.blocks.size())
+        return kDigestDifferent;
+
+    if (digest.exact == golden.exact)
+        return kDigestExact;
+
+    for (size_t i = 0, n = digest.blocks.size(); i < n; ++i) {
+        const DigestBlock &a = digest.blocks[i];
+        const DigestBlock &b = golden.blocks[i];
+        for (unsigned c = 0; c < 2; ++c) {
+            if (std::fabs(a.rms[c] - b.rms[c]) > epsilon ||
+                std::fabs(a.peak[c] - b.peak[c]) > epsilon)
+                return kDigestDifferent;
+        }
+    }
+
+    return kDigestWithinTolerance;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "../thirdparty/libADLMIDI/src/wopl/wopl_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+
+//
+struct FILE_deleter { void operator()(FILE *x) const noexcept { fclose(x); } };
+typedef std::unique_ptr<FILE, FILE_deleter> FILE_u;
+
+//
+struct WOPL_deleter { void operator()(WOPLFile *x) const noexcept { WOPL_Free(x); } };
+typedef std::unique_ptr<WOPLFile, WOPL_deleter> WOPLFile_u;
+
+//
+struct TimedMidiMessage {
+    double time;
+    uint8_t size;
+    uint8_t data[3];
+};
+
+bool readMidiFile(const char *filepath, std::vector<TimedMidiMessage> &messages);
+
+//
+bool loadPresetFromText(const char *filepath, float values[]);
+bool loadPresetFromBank(const char *filepath, unsigned program, float values[]);
+
+//
+enum OutputFormat {
+    kOutputWav,
+    kOutputRaw,
+    kOutputDigest,
+};
+
+bool writeOutputHeader(FILE *fh, OutputFormat format, unsigned sampleRate, uint64_t frames);
+bool writeOutputFrames(FILE *fh, const float *left, const float *right, unsigned frames);
+
+// digest of the output, for comparing renderings with stored golden files
+//  - a hash of the samples as they are, equal for bit-exact renderings
+//  - the RMS and peak levels of every block of frames, which are compared
+//    within a tolerance, so tiny differences of floating point are accepted
+enum { kDigestBlockFrames = 4096 };
+
+struct DigestBlock {
+    float rms[2];
+    float peak[2];
+};
+
+struct OutputDigest {
+    // FNV-1a of the samples
+    uint64_t exact = 0xcbf29ce484222325u;
+    uint64_t frames = 0;
+    std::vector<DigestBlock> blocks;
+
+    // accumulation of the current block
+    double sumSquares[2] = {};
+    float peak[2] = {};
+    unsigned blockFrames = 0;
+};
+
+void updateOutputDigest(OutputDigest &digest, const float *left, const float *right, unsigned frames);
+void finishOutputDigest(OutputDigest &digest);
+
+bool writeOutputDigest(FILE *fh, const OutputDigest &digest);
+bool readOutputDigest(const char *filepath, OutputDigest &digest);
+
+enum DigestMatch {
+    kDigestExact,
+    kDigestWithinTolerance,
+    kDigestDifferent,
+};
+
+DigestMatch compareOutputDigests(const OutputDigest &digest, const OutputDigest &golden, float epsilon);
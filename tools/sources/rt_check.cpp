@@ -0,0 +1,209 @@
+#include "rt_check.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#if defined(__GLIBC__)
+#   include <pthread.h>
+#   include <dlfcn.h>
+#   include <execinfo.h>
+#   define RT_CHECK_HAVE_GLIBC 1
+#endif
+
+// the interceptions are in a file of their own, like the counting operators
+// of alloc_count.cpp, and both cannot be linked in the same program
+
+static std::atomic<uint64_t> gViolationCount{0};
+static std::atomic<unsigned> gReportLimit{10};
+
+// the depth of real-time scopes, and if the thread is reporting a violation
+static thread_local unsigned tRtDepth = 0;
+static thread_local bool tReporting = false;
+
+uint64_t rtViolationCount()
+{
+    return gViolationCount.load(std::memory_order_relaxed);
+}
+
+void rtSetReportLimit(unsigned limit)
+{
+    gReportLimit.store(limit, std::memory_order_relaxed);
+}
+
+RtScope::RtScope() noexcept
+{
+    ++tRtDepth;
+}
+
+RtScope::~RtScope() noexcept
+{
+    --tRtDepth;
+}
+
+#if RT_CHECK_HAVE_GLIBC
+#   define RT_CHECK_NOINLINE __attribute__((noinline))
+#else
+#   define RT_CHECK_NOINLINE
+#endif
+
+RT_CHECK_NOINLINE static void printStack()
+{
+#if RT_CHECK_HAVE_GLIBC
+    void *frames[64];
+    int count = backtrace(frames, 64);
+    // without the frames of printStack and rtViolation
+    if (count > 2)
+        backtrace_symbols_fd(frames + 2, count - 2, 2);
+#endif
+}
+
+RT_CHECK_NOINLINE static void rtViolation(const char *operation, size_t size)
+{
+    if (tRtDepth == 0 || tReporting)
+        return;
+
+    tReporting = true;
+    uint64_t number = gViolationCount.fetch_add(1, std::memory_order_relaxed);
+    if (number < gReportLimit.load(std::memory_order_relaxed)) {
+        if (size > 0)
+            fprintf(stderr, "Real-time violation #%llu: %s (%zu bytes)\n",
+                    (unsigned long long)number + 1, operation, size);
+        else
+            fprintf(stderr, "Real-time violation #%llu: %s\n",
+                    (unsigned long long)number + 1, operation);
+        printStack();
+        fputc('\n', stderr);
+    }
+    tReporting = false;
+}
+
+void rtCheckInit()
+{
+#if RT_CHECK_HAVE_GLIBC
+    // the first backtrace loads the unwinder, which allocates
+    void *frames[1];
+    backtrace(frames, 1);
+#endif
+}
+
+//------------------------------------------------------------------------------
+#if RT_CHECK_HAVE_GLIBC
+
+// the allocations of operator new go through malloc
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) noexcept
+{
+    rtViolation("malloc", size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    rtViolation("calloc", count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept
+{
+    rtViolation("realloc", size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    rtViolation("memalign", size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    rtViolation("aligned_alloc", size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) noexcept
+{
+    rtViolation("posix_memalign", size);
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    void *mem = __libc_memalign(alignment, size);
+    if (!mem)
+        return ENOMEM;
+    *ptr = mem;
+    return 0;
+}
+
+void free(void *ptr) noexcept
+{
+    if (ptr)
+        rtViolation("free", 0);
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) noexcept
+{
+    typedef int (*lock_fn)(pthread_mutex_t *);
+    // resolved at first use, dlsym does not lock with this function
+    static std::atomic<lock_fn> next{nullptr};
+
+    lock_fn fn = next.load(std::memory_order_acquire);
+    if (!fn) {
+        fn = (lock_fn)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+        next.store(fn, std::memory_order_release);
+    }
+
+    rtViolation("pthread_mutex_lock", 0);
+    return fn(mutex);
+}
+
+} // extern "C"
+
+//------------------------------------------------------------------------------
+#else
+
+static void *checkedAlloc(size_t size)
+{
+    rtViolation("operator new", size);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = checkedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    void *ptr = checkedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return checkedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return checkedAlloc(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+#endif
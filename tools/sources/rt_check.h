@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// detection of the operations which are not real-time safe, the allocations
+// and the locks, when they happen on a thread inside a real-time scope
+//  - with glibc, malloc and its family are intercepted, and pthread mutexes
+//  - otherwise, only the global operator new is
+
+// prepare the reporting, before the first real-time scope
+void rtCheckInit();
+
+// number of violations, since the start
+uint64_t rtViolationCount();
+
+// limit of the violations which are reported with a call stack
+void rtSetReportLimit(unsigned limit);
+
+// marks the current thread as being in a real-time context
+class RtScope {
+public:
+    RtScope() noexcept;
+    ~RtScope() noexcept;
+
+private:
+    RtScope(const RtScope &) = delete;
+    RtScope &operator=(const RtScope &) = delete;
+};
@@ -0,0 +1,120 @@
+#include "rt_check.h"
+#include "random_block.h"
+#include "../../sources/plugin/CoreMiniOPL3.h"
+#include "../../sources/plugin/SharedMiniOPL3.h"
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <getopt.h>
+
+//------------------------------------------------------------------------------
+static const unsigned kSampleRate = 44100;
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: miniopl3-rtcheck [options]\n"
+        "  -d <seconds>   duration of the checked rendering (default: 10)\n"
+        "  -w <seconds>   duration of the warm-up, not checked (default: 1)\n"
+        "  -b <frames>    block size (default: 256)\n"
+        "  -s <seed>      seed of the random events (default: 1)\n"
+        "  -P             load a program every second, from the audio thread\n"
+        "  -a             write all the parameters, not only the automatable ones\n"
+        "  -n <count>     number of violations reported with a call stack (default: 10)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    double duration = 10;
+    double warmUp = 1;
+    unsigned blockSize = 256;
+    unsigned seed = 1;
+    bool programs = false;
+    bool allParameters = false;
+
+    for (int c; (c = getopt(argc, argv, "d:w:b:s:Pan:")) != -1;) {
+        switch (c) {
+        case 'd':
+            duration = std::atof(optarg);
+            break;
+        case 'w':
+            warmUp = std::atof(optarg);
+            break;
+        case 'b':
+            blockSize = std::atoi(optarg);
+            break;
+        case 's':
+            seed = std::atoi(optarg);
+            break;
+        case 'P':
+            programs = true;
+            break;
+        case 'a':
+            allParameters = true;
+            break;
+        case 'n':
+            rtSetReportLimit(std::atoi(optarg));
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc) {
+        usage();
+        return 1;
+    }
+
+    if (blockSize == 0 || blockSize > 8192 || !(duration > 0) || !(warmUp >= 0)) {
+        fprintf(stderr, "Invalid duration or block size.\n");
+        return 1;
+    }
+
+    rtCheckInit();
+
+    //
+    CoreMiniOPL3 core;
+    core.setSampleRate(kSampleRate);
+    core.setEmulator(ADLMIDI_EMU_DOSBOX);
+    core.activate();
+
+    std::unique_ptr<float[]> buffer{new float[2 * blockSize]};
+    float *outputs[] = {&buffer[0], &buffer[blockSize]};
+
+    std::mt19937 rng(seed);
+    RandomBlock block;
+
+    const unsigned long warmUpBlocks = (unsigned long)(warmUp * kSampleRate / blockSize);
+    const unsigned long checkedBlocks = (unsigned long)(duration * kSampleRate / blockSize) + 1;
+    const unsigned long programInterval = kSampleRate / blockSize + 1;
+
+    for (unsigned long i = 0; i < warmUpBlocks + checkedBlocks; ++i) {
+        randomBlock(rng, blockSize, block, allParameters);
+        const Program *program = nullptr;
+        if (programs && i % programInterval == 0)
+            program = &EmbeddedPrograms[(i / programInterval) % programCount];
+
+        auto process = [&]() {
+            if (program)
+                core.setParameterValues(program->values);
+            if (block.param != -1)
+                core.setParameterValue(block.param, block.value);
+            core.run(outputs, blockSize, block.events, block.eventCount);
+        };
+
+        // the warm-up fills the lazy state, like the voices and the banks
+        if (i < warmUpBlocks)
+            process();
+        else {
+            RtScope scope;
+            process();
+        }
+    }
+
+    uint64_t violations = rtViolationCount();
+    printf("%lu blocks of %u frames checked, %llu violations\n",
+           checkedBlocks, blockSize, (unsigned long long)violations);
+
+    return (violations > 0) ? 1 : 0;
+}
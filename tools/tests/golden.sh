@@ -0,0 +1,70 @@
+#!/bin/sh
+# Render the MIDI scripts with every emulator, algorithm and number of chips,
+# and compare the output with the golden digests, or update the digests.
+#
+# Usage: golden.sh check <miniopl3-render> [comparison options]
+#        golden.sh update <miniopl3-render>
+
+set -e
+
+mode="$1"
+render="$2"
+shift 2
+# the options of the comparison, like -x or -E <epsilon>
+options="$*"
+
+dir=$(dirname "$0")
+emulators="dosbox nuked nuked174"
+algorithms="0 1 2 3 4 5 6 7 8 9"
+chips="1 2 4"
+tail=0.5
+
+exact=0
+tolerance=0
+different=0
+missing=0
+
+if test "$mode" = update; then
+    mkdir -p "$dir/golden"
+fi
+
+for midi in "$dir"/midi/*.mid; do
+    name=$(basename "$midi" .mid)
+    for e in $emulators; do
+        for a in $algorithms; do
+            for c in $chips; do
+                golden="$dir/golden/$name-$e-a$a-c$c.txt"
+                set -- -t "$tail" -e "$e" -a "$a" -c "$c"
+                if test "$mode" = update; then
+                    "$render" "$@" -f digest -o "$golden" "$midi"
+                    continue
+                fi
+                if test ! -f "$golden"; then
+                    missing=$((missing + 1))
+                    continue
+                fi
+                if result=$("$render" "$@" $options -g "$golden" "$midi"); then
+                    case "$result" in
+                        *": exact") exact=$((exact + 1)) ;;
+                        *) tolerance=$((tolerance + 1)); echo "$result" ;;
+                    esac
+                else
+                    different=$((different + 1))
+                    echo "$result"
+                fi
+            done
+        done
+    done
+done
+
+if test "$mode" = update; then
+    exit 0
+fi
+
+echo "$exact exact, $tolerance within tolerance, $different different, $missing missing"
+
+if test "$missing" -gt 0; then
+    echo "The golden digests are missing, run \"make update-golden\" with the pinned submodules."
+fi
+
+test "$different" -eq 0 -a "$missing" -eq 0
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Convert every bank with bank2preset, back with preset2bank, and again with
+# bank2preset, in both formats and with the duplicates referenced, and check
+# the presets are identical.
+#
+# Usage: roundtrip.sh <bin-directory> <bank>...
+
+set -e
+
+bin="$1"
+shift
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+status=0
+
+for bank in "$@"; do
+    # the bank name is the file name, keep it the same
+    name=$(basename "$bank")
+    for format in cpp ttl dedup.ttl; do
+        case "$format" in
+            cpp) options="-w" ;;
+            ttl) options="-w -L urn:miniopl3:roundtrip#" ;;
+            dedup.ttl) options="-d -w -L urn:miniopl3:roundtrip#" ;;
+        esac
+        "$bin"/bank2preset $options "$bank" > "$tmp/presets.$format"
+        "$bin"/preset2bank -o "$tmp/$name" "$tmp/presets.$format"
+        "$bin"/bank2preset $options "$tmp/$name" > "$tmp/again.$format"
+        if ! cmp -s "$tmp/presets.$format" "$tmp/again.$format"; then
+            echo "$bank: the $format presets differ after the round trip"
+            status=1
+        fi
+        rm -f "$tmp/$name"
+    done
+done
+
+exit $status